@@ -0,0 +1,107 @@
+#include "addrsplit.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// The SIMD versions load the accesses as pairs of 64-bit lanes with the
+// address first
+_Static_assert(sizeof(mem_access_t) == 16,
+               "mem_access_t must be an address and 64 bits of type");
+
+void addr_split_scalar(const mem_access_t *const accesses, const size_t count,
+                       const uint32_t offset_bits, const uint32_t index_bits,
+                       uint32_t *const indexes, uint64_t *const tags) {
+    const uint32_t index_mask = (1U << index_bits) - 1;
+    for (size_t i = 0; i < count; i++) {
+        indexes[i] =
+            (uint32_t)(accesses[i].address >> offset_bits) & index_mask;
+        tags[i] = accesses[i].address >> (offset_bits + index_bits);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2"))) void
+addr_split_sse2(const mem_access_t *const accesses, const size_t count,
+                const uint32_t offset_bits, const uint32_t index_bits,
+                uint32_t *const indexes, uint64_t *const tags) {
+    const __m128i index_shift = _mm_cvtsi32_si128((int)offset_bits);
+    const __m128i tag_shift =
+        _mm_cvtsi32_si128((int)(offset_bits + index_bits));
+    const __m128i index_mask = _mm_set1_epi64x((1LL << index_bits) - 1);
+    size_t i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        // Keep the low lanes, which hold the addresses
+        const __m128i addresses = _mm_unpacklo_epi64(
+            _mm_loadu_si128((const __m128i *)(accesses + i)),
+            _mm_loadu_si128((const __m128i *)(accesses + i + 1)));
+        // The indexes fit in the low 32 bits of their lanes, so they are
+        // packed into the low half before being stored
+        const __m128i index =
+            _mm_and_si128(_mm_srl_epi64(addresses, index_shift), index_mask);
+        _mm_storel_epi64(
+            (__m128i *)(indexes + i),
+            _mm_shuffle_epi32(index, _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm_storeu_si128((__m128i *)(tags + i),
+                         _mm_srl_epi64(addresses, tag_shift));
+    }
+
+    addr_split_scalar(accesses + i, count - i, offset_bits, index_bits,
+                      indexes + i, tags + i);
+}
+
+__attribute__((target("avx2"))) void
+addr_split_avx2(const mem_access_t *const accesses, const size_t count,
+                const uint32_t offset_bits, const uint32_t index_bits,
+                uint32_t *const indexes, uint64_t *const tags) {
+    const __m128i index_shift = _mm_cvtsi32_si128((int)offset_bits);
+    const __m128i tag_shift =
+        _mm_cvtsi32_si128((int)(offset_bits + index_bits));
+    const __m256i index_mask =
+        _mm256_set1_epi64x((1LL << index_bits) - 1);
+    // Moves the low 32 bits of each 64-bit lane to the low half
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        // Each load holds two accesses, and unpacking keeps the addresses in
+        // the order 0, 2, 1, 3, which the permute puts back in order
+        const __m256i lo =
+            _mm256_loadu_si256((const __m256i *)(accesses + i));
+        const __m256i hi =
+            _mm256_loadu_si256((const __m256i *)(accesses + i + 2));
+        const __m256i addresses = _mm256_permute4x64_epi64(
+            _mm256_unpacklo_epi64(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i index = _mm256_permutevar8x32_epi32(
+            _mm256_and_si256(_mm256_srl_epi64(addresses, index_shift),
+                             index_mask),
+            even);
+        _mm_storeu_si128((__m128i *)(indexes + i),
+                         _mm256_castsi256_si128(index));
+        _mm256_storeu_si256((__m256i *)(tags + i),
+                            _mm256_srl_epi64(addresses, tag_shift));
+    }
+
+    // Calling the SSE2 split from here would mix VEX and legacy SSE code, so
+    // the last few addresses are split one at a time
+    addr_split_scalar(accesses + i, count - i, offset_bits, index_bits,
+                      indexes + i, tags + i);
+}
+
+addr_split_fn addr_split_select(void) {
+    if (__builtin_cpu_supports("avx2")) {
+        return addr_split_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return addr_split_sse2;
+    }
+    return addr_split_scalar;
+}
+
+#else
+
+addr_split_fn addr_split_select(void) { return addr_split_scalar; }
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef ADDRSPLIT_H
+#define ADDRSPLIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+// Splits the addresses of `count` accesses into the set index
+// (`index_bits` bits above the `offset_bits` block offset) and the tag (the
+// bits above the index) of a cache
+typedef void (*addr_split_fn)(const mem_access_t *accesses, size_t count,
+                              uint32_t offset_bits, uint32_t index_bits,
+                              uint32_t *indexes, uint64_t *tags);
+
+// Splits one address at a time
+void addr_split_scalar(const mem_access_t *accesses, size_t count,
+                       uint32_t offset_bits, uint32_t index_bits,
+                       uint32_t *indexes, uint64_t *tags);
+
+#if defined(__x86_64__) || defined(__i386__)
+// Splits 2 addresses per instruction with SSE2
+void addr_split_sse2(const mem_access_t *accesses, size_t count,
+                     uint32_t offset_bits, uint32_t index_bits,
+                     uint32_t *indexes, uint64_t *tags);
+
+// Splits 4 addresses per instruction with AVX2. Only call this if the host
+// supports AVX2.
+void addr_split_avx2(const mem_access_t *accesses, size_t count,
+                     uint32_t offset_bits, uint32_t index_bits,
+                     uint32_t *indexes, uint64_t *tags);
+#endif
+
+// Returns the fastest address split that the host supports
+addr_split_fn addr_split_select(void);
+
+#endif
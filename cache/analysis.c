@@ -0,0 +1,103 @@
+#include "analysis.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The initial size of a working set hash set
+enum { INITIAL_SET_CAPACITY = 1 << 10 };
+
+void reuse_histogram_init(reuse_histogram_t *const histogram) {
+    // Only the buckets are needed, not the exact distances
+    stack_distance_init(&histogram->engine, 0);
+    memset(histogram->buckets, 0, sizeof(histogram->buckets));
+    histogram->cold = 0;
+}
+
+void reuse_histogram_free(reuse_histogram_t *const histogram) {
+    stack_distance_free(&histogram->engine);
+}
+
+void reuse_histogram_add(reuse_histogram_t *const histogram,
+                         const uint64_t block) {
+    const uint64_t distance =
+        stack_distance_access(&histogram->engine, block);
+    if (distance == STACK_DISTANCE_COLD) {
+        histogram->cold++;
+    } else if (distance == 0) {
+        histogram->buckets[0]++;
+    } else {
+        histogram->buckets[64 - __builtin_clzll(distance)]++;
+    }
+}
+
+uint64_t reuse_bucket_min(const size_t bucket) {
+    return bucket == 0 ? 0 : 1ULL << (bucket - 1);
+}
+
+uint64_t reuse_bucket_max(const size_t bucket) {
+    if (bucket == 0) {
+        return 0;
+    }
+    return bucket == REUSE_BUCKETS - 1 ? UINT64_MAX : (1ULL << bucket) - 1;
+}
+
+// Returns the index of `key` in the hash set, or of the empty entry where it
+// would be inserted
+static size_t set_find(const working_set_t *const set, const uint64_t key) {
+    const size_t mask = set->capacity - 1;
+    size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+    while (set->keys[i] != 0 && set->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Doubles the size of the hash set
+static void set_grow(working_set_t *const set) {
+    uint64_t *const old_keys = set->keys;
+    const size_t old_capacity = set->capacity;
+
+    set->capacity *= 2;
+    set->keys = calloc(set->capacity, sizeof(uint64_t));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != 0) {
+            set->keys[set_find(set, old_keys[i])] = old_keys[i];
+        }
+    }
+
+    free(old_keys);
+}
+
+void working_set_init(working_set_t *const set) {
+    set->capacity = INITIAL_SET_CAPACITY;
+    set->count = 0;
+    set->keys = calloc(set->capacity, sizeof(uint64_t));
+}
+
+void working_set_free(working_set_t *const set) {
+    free(set->keys);
+    memset(set, 0, sizeof(working_set_t));
+}
+
+void working_set_add(working_set_t *const set, const uint64_t block) {
+    // Zero marks an empty entry
+    const uint64_t key = block + 1;
+    size_t i = set_find(set, key);
+    if (set->keys[i] == key) {
+        return;
+    }
+
+    if (2 * (set->count + 1) > set->capacity) {
+        set_grow(set);
+        i = set_find(set, key);
+    }
+    set->keys[i] = key;
+    set->count++;
+}
+
+void working_set_clear(working_set_t *const set) {
+    // The set grows only when half full and holds at most a window of blocks,
+    // so this is proportional to the window
+    memset(set->keys, 0, set->capacity * sizeof(uint64_t));
+    set->count = 0;
+}
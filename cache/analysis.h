@@ -0,0 +1,72 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stackdist.h"
+
+// The number of reuse distance buckets: bucket 0 holds the distance 0 and
+// bucket k > 0 the distances from 2^(k-1) to 2^k - 1
+enum { REUSE_BUCKETS = 65 };
+
+// A histogram of the reuse distances of a stream of block accesses, in
+// power of two buckets. The reuse distance of an access is its LRU stack
+// distance, the number of distinct blocks accessed since the previous access
+// to the same block.
+//
+// The distances are exact, so the engine remembers every distinct block of
+// the stream. Its memory is not bounded: it grows with the footprint of the
+// trace, though not with its length. The hash map entries and the time slots
+// of the engine take 12 bytes each, and there are two to four of each per
+// block, so with the copies made while they grow a block costs up to about
+// 120 bytes.
+typedef struct {
+    // Computes the stack distance of every access
+    stack_distance_t engine;
+    // The number of accesses in each bucket
+    uint64_t buckets[REUSE_BUCKETS];
+    // The number of first accesses to a block (infinite distance)
+    uint64_t cold;
+} reuse_histogram_t;
+
+// Counts the distinct blocks accessed in a window of the trace. Its memory is
+// proportional to the window, not to the trace, and clearing it costs O(1) per
+// access of the window.
+typedef struct {
+    // Open addressing hash set of blocks (plus one), zero marks an empty entry
+    uint64_t *keys;
+    // The size of the hash set, a power of two
+    size_t capacity;
+    // The number of blocks in the hash set
+    size_t count;
+} working_set_t;
+
+// Initializes an empty histogram
+void reuse_histogram_init(reuse_histogram_t *histogram);
+
+// Frees the memory of a histogram
+void reuse_histogram_free(reuse_histogram_t *histogram);
+
+// Records an access to `block` in O(log n)
+void reuse_histogram_add(reuse_histogram_t *histogram, uint64_t block);
+
+// Returns the smallest reuse distance in bucket `bucket`
+uint64_t reuse_bucket_min(size_t bucket);
+
+// Returns the largest reuse distance in bucket `bucket`
+uint64_t reuse_bucket_max(size_t bucket);
+
+// Initializes an empty working set
+void working_set_init(working_set_t *set);
+
+// Frees the memory of a working set
+void working_set_free(working_set_t *set);
+
+// Adds `block` to the working set
+void working_set_add(working_set_t *set, uint64_t block);
+
+// Removes every block from the working set
+void working_set_clear(working_set_t *set);
+
+#endif
@@ -0,0 +1,293 @@
+#define _DEFAULT_SOURCE
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "prefilter.h"
+#include "trace.h"
+
+enum { BATCH_SIZE = 4096 };
+
+// The default number of accesses in the generated trace
+#define DEFAULT_ACCESSES 10000000UL
+
+// Returns the current time in seconds from a monotonic clock
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// A xorshift64 pseudo-random number generator, so the trace is the same on
+// every run
+static uint64_t next_random(uint64_t *const state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+// Writes a trace of `accesses` accesses that mixes sequential instruction
+// fetches and data accesses with occasional jumps
+static void generate_trace(FILE *const file, const uint64_t accesses) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint32_t pc = 0x8cd94000;
+    uint32_t data = 0x10000000;
+
+    for (uint64_t i = 0; i < accesses; i++) {
+        const uint64_t r = next_random(&state);
+        if ((r & 0xff) < 166) {
+            pc = (r >> 8) % 10 != 0
+                     ? pc + 4
+                     : 0x8c000000 | ((uint32_t)(r >> 16) & 0xffffc);
+            fprintf(file, "I %x\n", pc);
+        } else {
+            data = (r >> 8) % 10 < 6
+                       ? data + 8
+                       : 0x10000000 | ((uint32_t)(r >> 16) & 0x7fff8);
+            fprintf(file, "D %x\n", data);
+        }
+    }
+}
+
+// The trace reader that was used before the memory mapped one: one fscanf call
+// per access
+static int fscanf_read(FILE *const file, mem_access_t *const access) {
+    char type;
+    if (fscanf(file, "%c %" SCNx64 "\n", &type, &access->address) != 2) {
+        return 0;
+    }
+    access->accessType = type == 'I' ? INSTRUCTION : DATA;
+    access->isWrite = type == 'S';
+    return 1;
+}
+
+// Folds an access into a checksum so the parsers can be compared and the
+// parsing cannot be optimized away
+static uint64_t checksum_add(const uint64_t sum, const mem_access_t access) {
+    return sum * 31 + access.address + (uint64_t)access.accessType;
+}
+
+// Reads the whole trace at `path` with the memory mapped reader and returns
+// the time it took in seconds
+static double read_trace(const char *const path, uint64_t *const accesses,
+                         uint64_t *const sum) {
+    static mem_access_t batch[BATCH_SIZE];
+    const double start = now();
+
+    trace_reader_t trace;
+    if (trace_open(&trace, path) < 0) {
+        printf("Unable to open the trace file\n");
+        exit(1);
+    }
+
+    trace_status_t status;
+    *accesses = 0;
+    *sum = 0;
+    do {
+        const size_t count =
+            trace_read_batch(&trace, batch, BATCH_SIZE, &status);
+        for (size_t i = 0; i < count; i++) {
+            *sum = checksum_add(*sum, batch[i]);
+        }
+        *accesses += count;
+    } while (status == TRACE_OK);
+    trace_close(&trace);
+
+    return now() - start;
+}
+
+// Converts the text trace at `text_path` to a binary trace at `binary_path`
+static void write_binary(const char *const text_path,
+                         const char *const binary_path) {
+    static mem_access_t batch[BATCH_SIZE];
+    static trace_writer_t writer;
+
+    trace_reader_t trace;
+    if (trace_open(&trace, text_path) < 0 ||
+        trace_writer_open(&writer, binary_path) < 0) {
+        printf("Unable to convert the trace file\n");
+        exit(1);
+    }
+
+    trace_status_t status;
+    do {
+        const size_t count =
+            trace_read_batch(&trace, batch, BATCH_SIZE, &status);
+        for (size_t i = 0; i < count; i++) {
+            trace_write(&writer, batch[i]);
+        }
+    } while (status == TRACE_OK);
+
+    trace_writer_close(&writer);
+    trace_close(&trace);
+}
+
+// Returns whether two runs produced the same statistics
+static int same_stats(const cache_stat_t *const a,
+                      const cache_stat_t *const b) {
+    return memcmp(a, b, sizeof(cache_stat_t)) == 0;
+}
+
+// Simulates `accesses` on the cache described by `spec` with the generic
+// per-access path, the generic batched path, the specialised kernel and the
+// kernel behind the pre-filter, and prints the throughput of each
+static void bench_kernels(const char *const spec,
+                          const mem_access_t *const accesses,
+                          const size_t count) {
+    cache_config_t config;
+    if (parse_cache_config(spec, &config) < 0 ||
+        cache_config_error(&config) != NULL) {
+        printf("Invalid cache configuration: %s\n", spec);
+        exit(1);
+    }
+
+    cache_stat_t stats[4];
+    double times[4];
+    memset(stats, 0, sizeof(stats));
+    static prefilter_t filter;
+
+    for (int path = 0; path < 4; path++) {
+        cache_context_t ctx;
+        if (create_context(&config, &ctx) < 0) {
+            printf("Unable to allocate the caches\n");
+            exit(1);
+        }
+        const cache_kernel_fn kernel = cache_select_kernel(&ctx);
+        prefilter_init(&filter, &ctx);
+        const double start = now();
+        for (size_t i = 0; i < count; i += BATCH_SIZE) {
+            const size_t n = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+            if (path == 0) {
+                for (size_t j = 0; j < n; j++) {
+                    cache_read(ctx, accesses[i + j], &stats[path]);
+                }
+            } else if (path == 1) {
+                cache_read_batch(ctx, accesses + i, n, &stats[path]);
+            } else if (path == 2) {
+                kernel(&ctx, accesses + i, n, &stats[path]);
+            } else {
+                prefilter_read_batch(&filter, kernel, &ctx, accesses + i, n,
+                                     &stats[path]);
+            }
+        }
+        times[path] = now() - start;
+        destroy_context(ctx);
+    }
+
+    if (!same_stats(&stats[0], &stats[1]) ||
+        !same_stats(&stats[0], &stats[2]) ||
+        !same_stats(&stats[0], &stats[3])) {
+        printf("The simulation paths disagree on %s\n", spec);
+        exit(1);
+    }
+
+    printf("%-16s %14.0f %14.0f %14.0f %14.0f %8.2fx\n", spec,
+           (double)count / times[0], (double)count / times[1],
+           (double)count / times[2], (double)count / times[3],
+           times[0] / times[2]);
+}
+
+int main(const int argc, const char **argv) {
+    // The number of accesses is parsed like the counts of the simulator
+    uint32_t count = DEFAULT_ACCESSES;
+    if (argc > 2 || (argc == 2 && parse_cache_size(argv[1], &count) < 0)) {
+        printf("usage: bench [number of accesses]\n");
+        exit(1);
+    }
+    const uint64_t accesses = count;
+
+    char path[] = "/tmp/cache_bench_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("Unable to create the trace file\n");
+        exit(1);
+    }
+    FILE *const file = fdopen(fd, "w");
+    generate_trace(file, accesses);
+    fclose(file);
+
+    printf("Parsing %" PRIu64 " accesses\n\n", accesses);
+
+    // Parse with fscanf
+    double start = now();
+    FILE *const scan_file = fopen(path, "r");
+    uint64_t scan_count = 0;
+    uint64_t scan_sum = 0;
+    mem_access_t access;
+    while (fscanf_read(scan_file, &access)) {
+        scan_sum = checksum_add(scan_sum, access);
+        scan_count++;
+    }
+    fclose(scan_file);
+    const double scan_time = now() - start;
+
+    // Parse with the memory mapped reader
+    uint64_t mmap_count;
+    uint64_t mmap_sum;
+    const double mmap_time = read_trace(path, &mmap_count, &mmap_sum);
+
+    // Convert to the binary format and read that
+    char binary_path[] = "/tmp/cache_bench_XXXXXX";
+    close(mkstemp(binary_path));
+    write_binary(path, binary_path);
+    uint64_t binary_count;
+    uint64_t binary_sum;
+    const double binary_time =
+        read_trace(binary_path, &binary_count, &binary_sum);
+
+    // Keep the decoded trace for the simulation benchmark
+    trace_reader_t trace;
+    if (trace_open(&trace, binary_path) < 0) {
+        printf("Unable to open the trace file\n");
+        exit(1);
+    }
+    size_t access_count;
+    trace_status_t status;
+    mem_access_t *const decoded =
+        trace_read_all(&trace, &access_count, &status);
+    trace_close(&trace);
+    if (decoded == NULL) {
+        printf("Unable to allocate the trace\n");
+        exit(1);
+    }
+
+    unlink(path);
+    unlink(binary_path);
+
+    if (scan_count != mmap_count || scan_sum != mmap_sum ||
+        scan_count != binary_count || scan_sum != binary_sum) {
+        printf("The parsers disagree on the trace contents\n");
+        exit(1);
+    }
+
+    printf("%-8s %10s %16s\n", "Reader", "Seconds", "Accesses/sec");
+    printf("%-8s %10.3f %16.0f\n", "fscanf", scan_time,
+           (double)scan_count / scan_time);
+    printf("%-8s %10.3f %16.0f\n", "mmap", mmap_time,
+           (double)mmap_count / mmap_time);
+    printf("%-8s %10.3f %16.0f\n", "binary", binary_time,
+           (double)binary_count / binary_time);
+    printf("\nSpeedup: %.1fx (mmap), %.1fx (binary)\n", scan_time / mmap_time,
+           scan_time / binary_time);
+
+    const char *const configs[] = {"1024:dm:uc",   "4096:dm:sc",
+                                   "8192:sa4:uc",  "32768:sa8:sc",
+                                   "1024:fa:uc",   "65536:fa:sc"};
+    printf("\nSimulating %zu accesses (accesses/sec)\n\n", access_count);
+    printf("%-16s %14s %14s %14s %14s %9s\n", "Cache", "cache_read",
+           "Batch", "Kernel", "Filtered", "Speedup");
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        bench_kernels(configs[i], decoded, access_count);
+    }
+    free(decoded);
+
+    return 0;
+}
@@ -0,0 +1,1086 @@
+#include "cache.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of accesses of a batch that are split into indexes and tags at a
+// time
+enum { SPLIT_CHUNK_SIZE = 256 };
+
+// Frees a cache and its lines
+static void destroy_cache(cache_t *const cache) {
+    free(cache->tags);
+    free(cache->valid);
+    free(cache->dirty);
+    free(cache->tag_index);
+    free(cache->fifo_next);
+    free(cache->fifo_prev);
+    free(cache->policy_state);
+    if (cache->classifier != NULL) {
+        miss_classifier_free(cache->classifier);
+        free(cache->classifier);
+    }
+    if (cache->prefetch != NULL) {
+        prefetch_unit_free(cache->prefetch);
+        free(cache->prefetch);
+    }
+    free(cache);
+}
+
+// Allocates a cache with `line_count` lines, with 64-bit tags if `wide_tags`
+// is set. Returns NULL if any of its memory cannot be allocated.
+static cache_t *create_cache(const uint32_t line_count,
+                             const cache_config_t *const config,
+                             const int wide_tags) {
+    cache_t *const cache = malloc(sizeof(cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    // Allocate zero-initialized memory for the cache lines. The tag array is
+    // padded to a multiple of 8 so SIMD loads never read past it.
+    cache->tags = calloc((line_count + 7) / 8 * 8,
+                         wide_tags ? sizeof(uint64_t) : sizeof(uint32_t));
+    cache->wide_tags = wide_tags;
+    cache->valid = calloc((line_count + 63) / 64, sizeof(uint64_t));
+    cache->dirty = calloc((line_count + 63) / 64, sizeof(uint64_t));
+    cache->size = line_count;
+    cache->fifo_next = NULL;
+    cache->fifo_prev = NULL;
+    cache->fifo_head = 0;
+    cache->tag_index = NULL;
+    cache->tag_index_bits = 0;
+    cache->find_tag = tag_find_select();
+    cache->find_tag64 = tag_find64_select();
+    cache->ways = 0;
+    cache->policy = NULL;
+    cache->policy_state = NULL;
+    cache->policy_state_size = 0;
+    cache->classifier = NULL;
+    cache->prefetch = NULL;
+
+    if (cache->tags == NULL || cache->valid == NULL || cache->dirty == NULL) {
+        destroy_cache(cache);
+        return NULL;
+    }
+
+    if (config->mapping == SET_ASSOCIATIVE) {
+        const uint32_t sets = line_count / config->ways;
+        cache->ways = config->ways;
+        cache->policy = config->policy;
+        cache->policy_state_size = config->policy->state_size(config->ways);
+        cache->policy_state = calloc(sets, cache->policy_state_size);
+        if (cache->policy_state == NULL) {
+            destroy_cache(cache);
+            return NULL;
+        }
+        for (uint32_t set = 0; set < sets; set++) {
+            cache->policy->init(
+                cache->policy_state + set * cache->policy_state_size,
+                cache->ways);
+        }
+    }
+
+    if (config->mapping == FULLY_ASSOCIATIVE) {
+        // The lines start out queued in order, so they are filled in order
+        cache->fifo_next = malloc(line_count * sizeof(uint32_t));
+        cache->fifo_prev = malloc(line_count * sizeof(uint32_t));
+        if (cache->fifo_next == NULL || cache->fifo_prev == NULL) {
+            destroy_cache(cache);
+            return NULL;
+        }
+        for (uint32_t i = 0; i < line_count; i++) {
+            cache->fifo_next[i] = (i + 1) % line_count;
+            cache->fifo_prev[i] = (i + line_count - 1) % line_count;
+        }
+    }
+
+    if (config->mapping == FULLY_ASSOCIATIVE &&
+        line_count > FA_SCAN_MAX_LINES) {
+        // Keep the tag index at most half full so probe sequences stay short
+        while ((1U << cache->tag_index_bits) < 2 * line_count) {
+            cache->tag_index_bits++;
+        }
+        cache->tag_index =
+            calloc((size_t)1 << cache->tag_index_bits, sizeof(uint32_t));
+        if (cache->tag_index == NULL) {
+            destroy_cache(cache);
+            return NULL;
+        }
+    }
+
+    if (config->classify_misses) {
+        cache->classifier = malloc(sizeof(miss_classifier_t));
+        if (cache->classifier == NULL ||
+            miss_classifier_init(cache->classifier, line_count) < 0) {
+            // The classifier frees its own memory when it cannot start
+            free(cache->classifier);
+            cache->classifier = NULL;
+            destroy_cache(cache);
+            return NULL;
+        }
+    }
+
+    if (config->prefetcher != NULL) {
+        cache->prefetch = malloc(sizeof(prefetch_unit_t));
+        if (cache->prefetch == NULL ||
+            prefetch_unit_init(cache->prefetch, config->prefetcher,
+                               config->prefetch_degree,
+                               config->prefetch_latency, line_count) < 0) {
+            free(cache->prefetch);
+            cache->prefetch = NULL;
+            destroy_cache(cache);
+            return NULL;
+        }
+    }
+
+    return cache;
+}
+
+// Returns whether `value` is a power of two
+static int is_power_of_two(const uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+// Returns log2(value) for a power of two
+static uint32_t log2_exact(const uint32_t value) {
+    return (uint32_t)__builtin_ctz(value);
+}
+
+// Returns the number of index bits of a cache of `config` with `line_count`
+// lines
+static uint32_t set_index_bits(const cache_config_t *const config,
+                               const uint32_t line_count) {
+    if (config->mapping == DIRECT_MAPPING) {
+        return log2_exact(line_count);
+    } else if (config->mapping == SET_ASSOCIATIVE) {
+        return log2_exact(line_count / config->ways);
+    }
+    return 0;
+}
+
+const char *cache_config_error(const cache_config_t *const config) {
+    if (!is_power_of_two(config->block_size) ||
+        config->block_size < STORE_SIZE) {
+        return "The block size must be a power of two of at least 4 bytes";
+    }
+    if (config->address_bits > MAX_ADDRESS_BITS) {
+        return "Addresses have at most 64 bits";
+    }
+
+    const uint32_t cache_size =
+        config->organization == SPLIT ? config->size / 2 : config->size;
+    const uint32_t line_count = cache_size / config->block_size;
+
+    if (line_count == 0) {
+        return "The cache is smaller than a block";
+    }
+    if (config->mapping == DIRECT_MAPPING && !is_power_of_two(line_count)) {
+        return "A direct mapped cache needs a power of two number of lines";
+    }
+    if (config->mapping == SET_ASSOCIATIVE) {
+        if (config->ways == 0 || config->ways > MAX_WAYS ||
+            line_count % config->ways != 0) {
+            return "The number of ways does not divide the number of lines";
+        }
+        if (!is_power_of_two(line_count / config->ways)) {
+            return "A set associative cache needs a power of two number of "
+                   "sets";
+        }
+        if (config->policy == &policy_plru && !is_power_of_two(config->ways)) {
+            return "Tree-PLRU needs a power of two number of ways";
+        }
+    }
+    // Every cache needs at least one tag bit
+    if (log2_exact(config->block_size) + set_index_bits(config, line_count) >=
+        config->address_bits) {
+        return "The addresses are too narrow for the blocks and sets";
+    }
+
+    return NULL;
+}
+
+int create_context(const cache_config_t *const config,
+                   cache_context_t *const ctx) {
+    uint32_t cache_size = config->size;
+    if (config->organization == SPLIT) {
+        cache_size /= 2;
+    }
+
+    const uint32_t line_count = cache_size / config->block_size;
+    const uint32_t offset_bits = log2_exact(config->block_size);
+    const uint32_t index_bits = set_index_bits(config, line_count);
+    const uint32_t tag_bits = config->address_bits - index_bits - offset_bits;
+    // Only the tag bits are stored, so most caches keep 32-bit tags
+    const int wide_tags = tag_bits > 32;
+
+    cache_t *const instr_cache = create_cache(line_count, config, wide_tags);
+    if (instr_cache == NULL) {
+        return -1;
+    }
+
+    cache_t *data_cache;
+    if (config->organization == UNIFIED) {
+        data_cache = instr_cache;
+    } else {
+        data_cache = create_cache(line_count, config, wide_tags);
+        if (data_cache == NULL) {
+            destroy_cache(instr_cache);
+            return -1;
+        }
+    }
+
+    *ctx = (cache_context_t){.instr_cache = instr_cache,
+                             .data_cache = data_cache,
+                             .mapping = config->mapping,
+                             .organization = config->organization,
+                             .offset_bits = offset_bits,
+                             .index_bits = index_bits,
+                             .tag_bits = tag_bits,
+                             .split_addresses = addr_split_select(),
+                             .write_policy = config->write_policy,
+                             .write_miss = config->write_miss};
+
+    return 0;
+}
+
+void destroy_context(const cache_context_t ctx) {
+    destroy_cache(ctx.instr_cache);
+
+    if (ctx.organization == SPLIT) {
+        destroy_cache(ctx.data_cache);
+    }
+}
+
+// Returns the tag of line `i` of the cache. `wide` is the wide_tags of the
+// cache, which callers pass as a constant where they can.
+static inline uint64_t line_tag(const cache_t *const cache, const int wide,
+                                const uintptr_t i) {
+    return wide ? ((const uint64_t *)cache->tags)[i]
+                : ((const uint32_t *)cache->tags)[i];
+}
+
+// Sets the tag of line `i` of the cache
+static inline void set_line_tag(cache_t *const cache, const int wide,
+                                const uintptr_t i, const uint64_t tag) {
+    if (wide) {
+        ((uint64_t *)cache->tags)[i] = tag;
+    } else {
+        ((uint32_t *)cache->tags)[i] = (uint32_t)tag;
+    }
+}
+
+// Returns the home entry of `tag` in the tag index
+static uint32_t tag_index_home(const cache_t *const cache, const uint64_t tag) {
+    // Fibonacci hashing spreads consecutive tags over the whole index
+    return (uint32_t)((tag * 0x9e3779b97f4a7c15ULL) >>
+                      (64 - cache->tag_index_bits));
+}
+
+// Returns the tag index entry that refers to the valid line with `tag`, or the
+// empty entry where such a line would be inserted
+static uint32_t tag_index_find(const cache_t *const cache, const int wide,
+                               const uint64_t tag) {
+    const uint32_t mask = (1U << cache->tag_index_bits) - 1;
+    uint32_t i = tag_index_home(cache, tag);
+    uint32_t entry;
+    while ((entry = cache->tag_index[i]) != 0 &&
+           line_tag(cache, wide, entry - 1) != tag) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Removes the entry at `i` from the tag index and shifts the following entries
+// of the probe sequence back, so lookups never need tombstones
+static void tag_index_remove(cache_t *const cache, const int wide,
+                             uint32_t i) {
+    const uint32_t mask = (1U << cache->tag_index_bits) - 1;
+    uint32_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        const uint32_t entry = cache->tag_index[j];
+        if (entry == 0) {
+            break;
+        }
+        // An entry can move back to `i` only if that does not put it before
+        // its home entry
+        const uint32_t home =
+            tag_index_home(cache, line_tag(cache, wide, entry - 1));
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            cache->tag_index[i] = entry;
+            i = j;
+        }
+    }
+    cache->tag_index[i] = 0;
+}
+
+// Returns whether line `i` of the cache contains valid data
+static inline int line_valid(const cache_t *const cache, const uintptr_t i) {
+    return (cache->valid[i / 64] >> (i % 64)) & 1;
+}
+
+// Marks line `i` of the cache as containing valid data
+static inline void set_line_valid(cache_t *const cache, const uintptr_t i) {
+    cache->valid[i / 64] |= 1ULL << (i % 64);
+}
+
+// Marks line `i` of the cache as not containing valid data
+static inline void clear_line_valid(cache_t *const cache, const uintptr_t i) {
+    cache->valid[i / 64] &= ~(1ULL << (i % 64));
+}
+
+// Returns whether line `i` of the cache was written since it was filled
+static inline int line_dirty(const cache_t *const cache, const uintptr_t i) {
+    return (cache->dirty[i / 64] >> (i % 64)) & 1;
+}
+
+// Sets whether line `i` of the cache was written since it was filled
+static inline void set_line_dirty(cache_t *const cache, const uintptr_t i,
+                                  const int dirty) {
+    const uint64_t bit = 1ULL << (i % 64);
+    cache->dirty[i / 64] =
+        dirty ? cache->dirty[i / 64] | bit : cache->dirty[i / 64] & ~bit;
+}
+
+uint64_t extract_bits(const uint64_t val, const uint32_t startBit,
+                      const uint32_t len) {
+    uint64_t mask = len >= 64 ? UINT64_MAX : (1ULL << len) - 1U;
+    return (val >> startBit) & mask;
+}
+
+// Searches `count` lines of a cache from line `first` for `tag` with SIMD
+// instructions, like a tag_find_fn
+static inline int32_t scan_tags(const cache_t *const cache, const int wide,
+                                const uint32_t first, const uint32_t count,
+                                const uint64_t tag) {
+    if (wide) {
+        return cache->find_tag64(cache->tags, cache->valid, first, count, tag);
+    }
+    return cache->find_tag(cache->tags, cache->valid, first, count,
+                           (uint32_t)tag);
+}
+
+// Searches the set `index` of a cache for `tag` and returns the line that holds
+// it, or -1 on a miss, without updating the replacement state. `wide` is the
+// wide_tags of the cache.
+static inline intptr_t lookup_line(const cache_map_t mapping, const int wide,
+                                   const cache_t *const cache,
+                                   const uint32_t index, const uint64_t tag) {
+    if (mapping == DIRECT_MAPPING) {
+        // The index has index_bits bits, so it is always in bounds
+        assert(index < cache->size);
+
+        // Check the cache line associated with this index
+        if (line_valid(cache, index) && line_tag(cache, wide, index) == tag) {
+            return (intptr_t)index;
+        }
+        return -1;
+    } else if (mapping == SET_ASSOCIATIVE) {
+        // Search the ways of the set for the tag
+        const uint32_t first = index * cache->ways;
+        const int32_t hit_way =
+            scan_tags(cache, wide, first, cache->ways, tag);
+        if (hit_way < 0) {
+            return -1;
+        }
+        return first + (uint32_t)hit_way;
+    } else if (cache->tag_index == NULL) {
+        // Small Fully Associative caches compare all the tags with SIMD
+        // instructions
+        return scan_tags(cache, wide, 0, (uint32_t)cache->size, tag);
+    } else {
+        // Large Fully Associative caches look up the line in the tag index
+        return (intptr_t)cache->tag_index[tag_index_find(cache, wide, tag)] -
+               1;
+    }
+}
+
+// Searches the set `index` of a cache for `tag` and returns the line that holds
+// it, or -1 on a miss. A hit updates the replacement state of the set.
+static inline intptr_t find_line(const cache_map_t mapping, const int wide,
+                                 cache_t *const cache, const uint32_t index,
+                                 const uint64_t tag) {
+    const intptr_t line = lookup_line(mapping, wide, cache, index, tag);
+    if (mapping == SET_ASSOCIATIVE && line >= 0) {
+        cache->policy->hit(cache->policy_state +
+                               index * cache->policy_state_size,
+                           cache->ways, (uint32_t)line - index * cache->ways);
+    }
+    return line;
+}
+
+// Inserts `tag`, which must not be cached, into the set `index` of a cache,
+// with the new line dirty if `dirty` is set, and sets `filled` to the line.
+// Returns 1 and sets `victim_tag` and `victim_dirty` if a valid line was
+// evicted, otherwise 0.
+static inline int insert_line(const cache_map_t mapping, const int wide,
+                              cache_t *const cache, const uint32_t index,
+                              const uint64_t tag, const int dirty,
+                              uint64_t *const victim_tag,
+                              int *const victim_dirty,
+                              uintptr_t *const filled) {
+    uintptr_t line;
+
+    if (mapping == DIRECT_MAPPING) {
+        // Replace the cached value
+        line = index;
+    } else if (mapping == SET_ASSOCIATIVE) {
+        // Fill an invalid way if there is one, otherwise evict a victim
+        const uint32_t first = index * cache->ways;
+        uint8_t *const state =
+            cache->policy_state + index * cache->policy_state_size;
+        uint32_t way = 0;
+        while (way < cache->ways && line_valid(cache, first + way)) {
+            way++;
+        }
+        if (way == cache->ways) {
+            way = cache->policy->victim(state, cache->ways);
+        }
+        cache->policy->fill(state, cache->ways, way);
+        line = first + way;
+    } else {
+        // Mapping is Fully associative, so the oldest line is refilled. The
+        // queue is circular, so moving the head past it makes it the newest.
+        line = cache->fifo_head;
+        cache->fifo_head = cache->fifo_next[line];
+
+        if (cache->tag_index != NULL && line_valid(cache, line)) {
+            // The evicted line must be removed from the index first, since
+            // removing shifts the following entries
+            tag_index_remove(
+                cache, wide,
+                tag_index_find(cache, wide, line_tag(cache, wide, line)));
+        }
+    }
+
+    const int evicted = line_valid(cache, line);
+    *victim_tag = line_tag(cache, wide, line);
+    *victim_dirty = evicted && line_dirty(cache, line);
+
+    set_line_valid(cache, line);
+    set_line_dirty(cache, line, dirty);
+    set_line_tag(cache, wide, line, tag);
+    if (cache->tag_index != NULL) {
+        cache->tag_index[tag_index_find(cache, wide, tag)] =
+            (uint32_t)line + 1;
+    }
+
+    *filled = line;
+    return evicted;
+}
+
+// Returns the cache of a context that holds the accesses of type `type`
+static inline cache_t *cache_for(const cache_context_t *const ctx,
+                                 const access_t type) {
+    return type == INSTRUCTION ? ctx->instr_cache : ctx->data_cache;
+}
+
+// The traffic between a cache and the next level
+typedef struct {
+    // The stores
+    uint64_t writes;
+    // The blocks fetched from the next level
+    uint64_t fills;
+    // The dirty blocks written back when they were evicted
+    uint64_t writebacks;
+    // The stores written to the next level as they happened
+    uint64_t stores_through;
+} traffic_t;
+
+// Simulates an access to `tag` in the set `index` of a cache, which is in
+// `block` and is a store if `is_write` is set, and counts the traffic it
+// causes. Returns how the access was served; anything but DEMAND_MISS is a
+// hit. The prefetch stage is only consulted if `prefetch` is set, which
+// callers pass as a constant so caches without one pay nothing for it.
+static inline __attribute__((always_inline)) demand_outcome_t
+access_line(const cache_map_t mapping, const int wide, cache_t *const cache,
+            const uint32_t index, const uint64_t tag, const uint64_t block,
+            const int is_write, const write_policy_t write_policy,
+            const write_miss_t write_miss, const int prefetch,
+            traffic_t *const traffic) {
+    traffic->writes += (uint64_t)is_write;
+    const intptr_t line = find_line(mapping, wide, cache, index, tag);
+    if (line >= 0) {
+        if (is_write) {
+            if (write_policy == WRITE_BACK) {
+                set_line_dirty(cache, (uintptr_t)line, 1);
+            } else {
+                traffic->stores_through++;
+            }
+        }
+        return prefetch ? prefetch_hit(cache->prefetch, (uintptr_t)line)
+                        : DEMAND_HIT;
+    }
+
+    const int allocate = !is_write || write_miss == WRITE_ALLOCATE;
+    // A buffered prefetcher may already hold the block, so it is not fetched
+    // again
+    const int prefetched =
+        prefetch && prefetch_miss(cache->prefetch, block, allocate);
+    if (!allocate) {
+        traffic->stores_through++;
+        return DEMAND_MISS;
+    }
+
+    uint64_t victim_tag;
+    int victim_dirty;
+    uintptr_t filled;
+    insert_line(mapping, wide, cache, index, tag,
+                is_write && write_policy == WRITE_BACK, &victim_tag,
+                &victim_dirty, &filled);
+    traffic->fills += (uint64_t)!prefetched;
+    traffic->writebacks += (uint64_t)victim_dirty;
+    if (is_write && write_policy == WRITE_THROUGH) {
+        traffic->stores_through++;
+    }
+    if (prefetch) {
+        cache->prefetch->prefetched_at[filled] = 0;
+    }
+    return prefetched ? DEMAND_PREFETCHED : DEMAND_MISS;
+}
+
+// Lets the prefetcher of a cache observe a demand access to `block` and issues
+// the prefetches it asks for. Blocks that are already cached are not fetched
+// again.
+static void issue_prefetches(const cache_context_t *const ctx,
+                             const cache_map_t mapping, const int wide,
+                             cache_t *const cache, const uint64_t block,
+                             const demand_outcome_t outcome) {
+    prefetch_unit_t *const unit = cache->prefetch;
+    const uint32_t index_bits = ctx->index_bits;
+    uint64_t blocks[PREFETCH_MAX_DEGREE];
+    const uint32_t count =
+        unit->prefetcher->access(unit->state, unit->degree, block, outcome,
+                                 unit->clock, blocks);
+
+    if (unit->prefetcher->take != NULL) {
+        // The prefetcher holds the blocks in its own buffers
+        unit->issued += count;
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        // Blocks past the end of the address space cannot be fetched
+        if (blocks[i] >> (index_bits + ctx->tag_bits) != 0) {
+            continue;
+        }
+        const uint32_t index = (uint32_t)blocks[i] & ((1U << index_bits) - 1);
+        const uint64_t tag = blocks[i] >> index_bits;
+        if (lookup_line(mapping, wide, cache, index, tag) >= 0) {
+            continue;
+        }
+
+        uint64_t victim_tag;
+        int victim_dirty;
+        uintptr_t filled;
+        const int evicted =
+            insert_line(mapping, wide, cache, index, tag, 0, &victim_tag,
+                        &victim_dirty, &filled);
+        unit->writebacks += (uint64_t)victim_dirty;
+        prefetch_filled(unit, filled, blocks[i], evicted,
+                        victim_tag << index_bits | index);
+    }
+}
+
+// Adds the prefetches of a cache with `block_size` byte blocks since the last
+// call, and the traffic they caused, to the statistics
+static void add_prefetches(cache_stat_t *const stat, cache_t *const cache,
+                           const uint64_t block_size) {
+    prefetch_unit_t *const unit = cache->prefetch;
+    stat->prefetches_issued += unit->issued;
+    stat->prefetches_useful += unit->useful;
+    stat->prefetches_late += unit->late;
+    stat->prefetches_polluting += unit->polluting;
+    stat->writebacks += unit->writebacks;
+    stat->bytes_read += unit->issued * block_size;
+    stat->bytes_written += unit->writebacks * block_size;
+    unit->issued = 0;
+    unit->useful = 0;
+    unit->late = 0;
+    unit->polluting = 0;
+    unit->writebacks = 0;
+}
+
+// Adds the traffic of a batch on a cache with `block_size` byte blocks to the
+// statistics
+static inline void add_traffic(cache_stat_t *const stat,
+                               const traffic_t *const traffic,
+                               const uint64_t block_size) {
+    stat->writes += traffic->writes;
+    stat->writebacks += traffic->writebacks;
+    stat->bytes_read += traffic->fills * block_size;
+    stat->bytes_written += traffic->writebacks * block_size +
+                           traffic->stores_through * STORE_SIZE;
+}
+
+// Adds the misses of each miss_class_t to the statistics
+static inline void add_misses(cache_stat_t *const stat,
+                              const uint64_t misses[4]) {
+    stat->compulsory_misses += misses[MISS_COMPULSORY];
+    stat->capacity_misses += misses[MISS_CAPACITY];
+    stat->conflict_misses += misses[MISS_CONFLICT];
+}
+
+void cache_read(const cache_context_t ctx, const mem_access_t access,
+                cache_stat_t *const stat) {
+    stat->accesses++;
+
+    uint32_t index = (uint32_t)extract_bits(access.address, ctx.offset_bits,
+                                            ctx.index_bits);
+    uint64_t tag = extract_bits(access.address,
+                                ctx.offset_bits + ctx.index_bits, ctx.tag_bits);
+
+    cache_t *const cache = cache_for(&ctx, access.accessType);
+    // The cache hits for this specific cache (in case of split organization)
+    uint64_t *cache_hits;
+    if (access.accessType == INSTRUCTION) {
+        cache_hits = &stat->instr_hits;
+        stat->instr_accesses++;
+    } else {
+        cache_hits = &stat->data_hits;
+        stat->data_accesses++;
+    }
+
+    const uint64_t block = access.address >> ctx.offset_bits;
+    const uint64_t block_size = (uint64_t)1 << ctx.offset_bits;
+    const int prefetch = cache->prefetch != NULL;
+    traffic_t traffic = {0, 0, 0, 0};
+    const demand_outcome_t outcome = access_line(
+        ctx.mapping, cache->wide_tags, cache, index, tag, block,
+        access.isWrite, ctx.write_policy, ctx.write_miss, prefetch, &traffic);
+    const int hit = outcome != DEMAND_MISS;
+    if (hit) {
+        stat->hits++;
+        (*cache_hits)++;
+    }
+    add_traffic(stat, &traffic, block_size);
+
+    if (prefetch) {
+        issue_prefetches(&ctx, ctx.mapping, cache->wide_tags, cache, block,
+                         outcome);
+        add_prefetches(stat, cache, block_size);
+    }
+
+    if (cache->classifier != NULL) {
+        uint64_t misses[4] = {0, 0, 0, 0};
+        misses[miss_classify(cache->classifier, block, hit)]++;
+        add_misses(stat, misses);
+    }
+}
+
+// Simulates a batch of accesses on a cache with `mapping` and `organization`,
+// with 64-bit tags if `wide` is set, classifying the misses if `classify` is
+// set and running the prefetch stages if `prefetch` is set. The specialised
+// kernels below pass them as constants, so after inlining their loops have no
+// branches on the configuration.
+static inline __attribute__((always_inline)) void
+read_kernel(const cache_context_t *const ctx,
+            const mem_access_t *const accesses, const size_t count,
+            cache_stat_t *const stat, const cache_map_t mapping,
+            const cache_org_t organization, const int wide, const int classify,
+            const int prefetch) {
+    cache_t *const instr_cache = ctx->instr_cache;
+    cache_t *const data_cache = ctx->data_cache;
+    const addr_split_fn split_addresses = ctx->split_addresses;
+    const uint32_t offset_bits = ctx->offset_bits;
+    const uint32_t index_bits = ctx->index_bits;
+    const write_policy_t write_policy = ctx->write_policy;
+    const write_miss_t write_miss = ctx->write_miss;
+
+    uint32_t indexes[SPLIT_CHUNK_SIZE];
+    uint64_t tags[SPLIT_CHUNK_SIZE];
+    // The accesses and hits of each access type
+    uint64_t type_accesses[2] = {0, 0};
+    uint64_t type_hits[2] = {0, 0};
+    // The accesses of each miss_class_t
+    uint64_t misses[4] = {0, 0, 0, 0};
+    traffic_t traffic = {0, 0, 0, 0};
+
+    for (size_t start = 0; start < count; start += SPLIT_CHUNK_SIZE) {
+        const size_t n =
+            count - start < SPLIT_CHUNK_SIZE ? count - start : SPLIT_CHUNK_SIZE;
+        split_addresses(accesses + start, n, offset_bits, index_bits, indexes,
+                        tags);
+
+        for (size_t i = 0; i < n; i++) {
+            const access_t type = accesses[start + i].accessType;
+            cache_t *const cache =
+                organization == UNIFIED || type == INSTRUCTION ? instr_cache
+                                                               : data_cache;
+            const uint64_t block = accesses[start + i].address >> offset_bits;
+            type_accesses[type]++;
+            const demand_outcome_t outcome = access_line(
+                mapping, wide, cache, indexes[i], tags[i], block,
+                accesses[start + i].isWrite, write_policy, write_miss,
+                prefetch, &traffic);
+            const int hit = outcome != DEMAND_MISS;
+            type_hits[type] += (uint64_t)hit;
+
+            if (prefetch) {
+                issue_prefetches(ctx, mapping, wide, cache, block, outcome);
+            }
+            if (classify) {
+                misses[miss_classify(cache->classifier, block, hit)]++;
+            }
+        }
+    }
+
+    stat->accesses += count;
+    stat->hits += type_hits[INSTRUCTION] + type_hits[DATA];
+    stat->instr_accesses += type_accesses[INSTRUCTION];
+    stat->instr_hits += type_hits[INSTRUCTION];
+    stat->data_accesses += type_accesses[DATA];
+    stat->data_hits += type_hits[DATA];
+    add_misses(stat, misses);
+    const uint64_t block_size = (uint64_t)1 << offset_bits;
+    add_traffic(stat, &traffic, block_size);
+    if (prefetch) {
+        add_prefetches(stat, instr_cache, block_size);
+        if (organization == SPLIT) {
+            add_prefetches(stat, data_cache, block_size);
+        }
+    }
+}
+
+void cache_read_batch(const cache_context_t ctx,
+                      const mem_access_t *const accesses, const size_t count,
+                      cache_stat_t *const stat) {
+    read_kernel(&ctx, accesses, count, stat, ctx.mapping, ctx.organization,
+                ctx.instr_cache->wide_tags, ctx.instr_cache->classifier != NULL,
+                ctx.instr_cache->prefetch != NULL);
+}
+
+// Defines the kernel `name` for a mapping and organization, with or without
+// 64-bit tags, miss classification and prefetching
+#define DEFINE_KERNEL(name, mapping, organization, wide, classify, prefetch)   \
+    static void name(const cache_context_t *const ctx,                         \
+                     const mem_access_t *const accesses, const size_t count,   \
+                     cache_stat_t *const stat) {                               \
+        read_kernel(ctx, accesses, count, stat, mapping, organization, wide,   \
+                    classify, prefetch);                                       \
+    }
+
+// Defines the kernel `name` for 32-bit tags and `name_wide` for 64-bit tags
+#define DEFINE_KERNELS(name, mapping, organization, classify, prefetch)        \
+    DEFINE_KERNEL(name, mapping, organization, 0, classify, prefetch)          \
+    DEFINE_KERNEL(name##_wide, mapping, organization, 1, classify, prefetch)
+
+// Prefetching is slow anyway, so its kernels check for miss classification at
+// run time rather than doubling their number
+#define CLASSIFY_AT_RUN_TIME (ctx->instr_cache->classifier != NULL)
+
+DEFINE_KERNELS(read_dm_uc, DIRECT_MAPPING, UNIFIED, 0, 0)
+DEFINE_KERNELS(read_dm_sc, DIRECT_MAPPING, SPLIT, 0, 0)
+DEFINE_KERNELS(read_sa_uc, SET_ASSOCIATIVE, UNIFIED, 0, 0)
+DEFINE_KERNELS(read_sa_sc, SET_ASSOCIATIVE, SPLIT, 0, 0)
+DEFINE_KERNELS(read_fa_uc, FULLY_ASSOCIATIVE, UNIFIED, 0, 0)
+DEFINE_KERNELS(read_fa_sc, FULLY_ASSOCIATIVE, SPLIT, 0, 0)
+DEFINE_KERNELS(classify_dm_uc, DIRECT_MAPPING, UNIFIED, 1, 0)
+DEFINE_KERNELS(classify_dm_sc, DIRECT_MAPPING, SPLIT, 1, 0)
+DEFINE_KERNELS(classify_sa_uc, SET_ASSOCIATIVE, UNIFIED, 1, 0)
+DEFINE_KERNELS(classify_sa_sc, SET_ASSOCIATIVE, SPLIT, 1, 0)
+DEFINE_KERNELS(classify_fa_uc, FULLY_ASSOCIATIVE, UNIFIED, 1, 0)
+DEFINE_KERNELS(classify_fa_sc, FULLY_ASSOCIATIVE, SPLIT, 1, 0)
+DEFINE_KERNELS(prefetch_dm_uc, DIRECT_MAPPING, UNIFIED, CLASSIFY_AT_RUN_TIME,
+               1)
+DEFINE_KERNELS(prefetch_dm_sc, DIRECT_MAPPING, SPLIT, CLASSIFY_AT_RUN_TIME, 1)
+DEFINE_KERNELS(prefetch_sa_uc, SET_ASSOCIATIVE, UNIFIED, CLASSIFY_AT_RUN_TIME,
+               1)
+DEFINE_KERNELS(prefetch_sa_sc, SET_ASSOCIATIVE, SPLIT, CLASSIFY_AT_RUN_TIME,
+               1)
+DEFINE_KERNELS(prefetch_fa_uc, FULLY_ASSOCIATIVE, UNIFIED,
+               CLASSIFY_AT_RUN_TIME, 1)
+DEFINE_KERNELS(prefetch_fa_sc, FULLY_ASSOCIATIVE, SPLIT, CLASSIFY_AT_RUN_TIME,
+               1)
+
+// The table of the `kind` kernels of every mapping and organization, with
+// `suffix` empty for 32-bit tags or _wide for 64-bit tags
+#define KERNEL_TABLE(kind, suffix)                                             \
+    {                                                                          \
+        [DIRECT_MAPPING] = {[UNIFIED] = kind##_dm_uc##suffix,                  \
+                            [SPLIT] = kind##_dm_sc##suffix},                   \
+        [SET_ASSOCIATIVE] = {[UNIFIED] = kind##_sa_uc##suffix,                 \
+                             [SPLIT] = kind##_sa_sc##suffix},                  \
+        [FULLY_ASSOCIATIVE] = {[UNIFIED] = kind##_fa_uc##suffix,               \
+                               [SPLIT] = kind##_fa_sc##suffix},                \
+    }
+
+cache_kernel_fn cache_select_kernel(const cache_context_t *const ctx) {
+    // Indexed by whether the tags are 64-bit, the mapping and the
+    // organization
+    static const cache_kernel_fn kernels[2][3][2] = {
+        KERNEL_TABLE(read, ), KERNEL_TABLE(read, _wide)};
+    static const cache_kernel_fn classify_kernels[2][3][2] = {
+        KERNEL_TABLE(classify, ), KERNEL_TABLE(classify, _wide)};
+    static const cache_kernel_fn prefetch_kernels[2][3][2] = {
+        KERNEL_TABLE(prefetch, ), KERNEL_TABLE(prefetch, _wide)};
+    const int wide = ctx->instr_cache->wide_tags;
+
+    if (ctx->instr_cache->prefetch != NULL) {
+        return prefetch_kernels[wide][ctx->mapping][ctx->organization];
+    }
+    if (ctx->instr_cache->classifier != NULL) {
+        return classify_kernels[wide][ctx->mapping][ctx->organization];
+    }
+    return kernels[wide][ctx->mapping][ctx->organization];
+}
+
+int cache_probe(const cache_context_t ctx, const mem_access_t access) {
+    const uint32_t index = (uint32_t)extract_bits(
+        access.address, ctx.offset_bits, ctx.index_bits);
+    const uint64_t tag = extract_bits(
+        access.address, ctx.offset_bits + ctx.index_bits, ctx.tag_bits);
+
+    cache_t *const cache = cache_for(&ctx, access.accessType);
+    return find_line(ctx.mapping, cache->wide_tags, cache, index, tag) >= 0;
+}
+
+int cache_fill(const cache_context_t ctx, const mem_access_t access,
+               uint64_t *const victim) {
+    const uint32_t index = (uint32_t)extract_bits(
+        access.address, ctx.offset_bits, ctx.index_bits);
+    const uint64_t tag = extract_bits(
+        access.address, ctx.offset_bits + ctx.index_bits, ctx.tag_bits);
+
+    cache_t *const cache = cache_for(&ctx, access.accessType);
+    uint64_t victim_tag;
+    int victim_dirty;
+    uintptr_t filled;
+    if (!insert_line(ctx.mapping, cache->wide_tags, cache, index, tag, 0,
+                     &victim_tag, &victim_dirty, &filled)) {
+        return 0;
+    }
+
+    // Rebuild the address of the first byte of the evicted block
+    *victim = victim_tag << (ctx.offset_bits + ctx.index_bits) |
+              (uint64_t)index << ctx.offset_bits;
+    return 1;
+}
+
+// Moves line `line` of a Fully Associative cache to the head of its FIFO queue
+static void fifo_requeue(cache_t *const cache, const uint32_t line) {
+    const uint32_t head = (uint32_t)cache->fifo_head;
+    if (line == head) {
+        return;
+    }
+
+    // Unlink the line and insert it between the newest line and the head
+    cache->fifo_next[cache->fifo_prev[line]] = cache->fifo_next[line];
+    cache->fifo_prev[cache->fifo_next[line]] = cache->fifo_prev[line];
+    cache->fifo_next[line] = head;
+    cache->fifo_prev[line] = cache->fifo_prev[head];
+    cache->fifo_next[cache->fifo_prev[head]] = line;
+    cache->fifo_prev[head] = line;
+    cache->fifo_head = line;
+}
+
+// Removes `tag` from the set `index` of a cache. Returns 1 if it was cached,
+// otherwise 0.
+static int remove_line(const cache_context_t *const ctx, cache_t *const cache,
+                       const uint32_t index, const uint64_t tag) {
+    const intptr_t line =
+        find_line(ctx->mapping, cache->wide_tags, cache, index, tag);
+    if (line < 0) {
+        return 0;
+    }
+
+    // The freed way of a Set Associative cache is filled before any victim
+    // is chosen. A freed line of a Fully Associative cache is moved to the
+    // head of the FIFO queue, so it is filled next.
+    if (cache->tag_index != NULL) {
+        tag_index_remove(cache, cache->wide_tags,
+                         tag_index_find(cache, cache->wide_tags, tag));
+    }
+    if (ctx->mapping == FULLY_ASSOCIATIVE) {
+        fifo_requeue(cache, (uint32_t)line);
+    }
+    clear_line_valid(cache, (uintptr_t)line);
+
+    return 1;
+}
+
+int cache_invalidate(const cache_context_t ctx, const uint64_t address) {
+    const uint32_t index =
+        (uint32_t)extract_bits(address, ctx.offset_bits, ctx.index_bits);
+    const uint64_t tag =
+        extract_bits(address, ctx.offset_bits + ctx.index_bits, ctx.tag_bits);
+
+    int removed = remove_line(&ctx, ctx.instr_cache, index, tag);
+    if (ctx.organization == SPLIT) {
+        removed |= remove_line(&ctx, ctx.data_cache, index, tag);
+    }
+
+    return removed;
+}
+
+int cache_evict(const cache_context_t ctx, const mem_access_t access) {
+    const uint32_t index = (uint32_t)extract_bits(
+        access.address, ctx.offset_bits, ctx.index_bits);
+    const uint64_t tag = extract_bits(
+        access.address, ctx.offset_bits + ctx.index_bits, ctx.tag_bits);
+
+    return remove_line(&ctx, cache_for(&ctx, access.accessType), index, tag);
+}
+
+void cache_stat_add(cache_stat_t *const total,
+                    const cache_stat_t *const part) {
+    total->accesses += part->accesses;
+    total->hits += part->hits;
+    total->instr_accesses += part->instr_accesses;
+    total->instr_hits += part->instr_hits;
+    total->data_accesses += part->data_accesses;
+    total->data_hits += part->data_hits;
+    total->compulsory_misses += part->compulsory_misses;
+    total->capacity_misses += part->capacity_misses;
+    total->conflict_misses += part->conflict_misses;
+    total->writes += part->writes;
+    total->writebacks += part->writebacks;
+    total->bytes_read += part->bytes_read;
+    total->bytes_written += part->bytes_written;
+    total->prefetches_issued += part->prefetches_issued;
+    total->prefetches_useful += part->prefetches_useful;
+    total->prefetches_late += part->prefetches_late;
+    total->prefetches_polluting += part->prefetches_polluting;
+}
+
+int parse_cache_size(const char *const str, uint32_t *const size) {
+    char *end;
+    const unsigned long value = strtoul(str, &end, 10);
+    if (end == str || *end != '\0' || value == 0 || value > UINT32_MAX) {
+        return -1;
+    }
+
+    *size = (uint32_t)value;
+    return 0;
+}
+
+int parse_cache_mapping(const char *const str, cache_map_t *const mapping,
+                        uint32_t *const ways) {
+    if (strcmp(str, "dm") == 0) {
+        *mapping = DIRECT_MAPPING;
+    } else if (strcmp(str, "fa") == 0) {
+        *mapping = FULLY_ASSOCIATIVE;
+    } else if (strncmp(str, "sa", 2) == 0 &&
+               parse_cache_size(str + 2, ways) == 0) {
+        *mapping = SET_ASSOCIATIVE;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+int parse_cache_org(const char *const str, cache_org_t *const org) {
+    if (strcmp(str, "uc") == 0) {
+        *org = UNIFIED;
+    } else if (strcmp(str, "sc") == 0) {
+        *org = SPLIT;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+int parse_cache_config(const char *const spec, cache_config_t *const config) {
+    // Split a copy of the spec at the colons
+    char fields[4][32];
+    int field_count = 0;
+    const char *start = spec;
+    while (1) {
+        const char *end = strchr(start, ':');
+        if (end == NULL) {
+            end = start + strlen(start);
+        }
+        if (field_count == 4 || (size_t)(end - start) >= sizeof(fields[0])) {
+            return -1;
+        }
+        memcpy(fields[field_count], start, (size_t)(end - start));
+        fields[field_count][end - start] = '\0';
+        field_count++;
+        if (*end == '\0') {
+            break;
+        }
+        start = end + 1;
+    }
+    if (field_count < 3) {
+        return -1;
+    }
+
+    config->ways = 0;
+    config->block_size = DEFAULT_BLOCK_SIZE;
+    config->address_bits = DEFAULT_ADDRESS_BITS;
+    config->policy = NULL;
+    config->classify_misses = 0;
+    config->write_policy = WRITE_BACK;
+    config->write_miss = WRITE_ALLOCATE;
+    config->prefetcher = NULL;
+    config->prefetch_degree = 0;
+    config->prefetch_latency = PREFETCH_DEFAULT_LATENCY;
+    if (parse_cache_size(fields[0], &config->size) < 0 ||
+        parse_cache_mapping(fields[1], &config->mapping, &config->ways) < 0 ||
+        parse_cache_org(fields[2], &config->organization) < 0) {
+        return -1;
+    }
+
+    return parse_cache_policy(field_count == 4 ? fields[3] : NULL, config);
+}
+
+int parse_cache_policy(const char *const str, cache_config_t *const config) {
+    if (config->mapping != SET_ASSOCIATIVE) {
+        // Only Set Associative caches have a choice of replacement policy
+        return str == NULL ? 0 : -1;
+    }
+
+    config->policy = str == NULL ? &policy_lru : find_replacement_policy(str);
+    return config->policy == NULL ? -1 : 0;
+}
+
+int parse_write_policy(const char *const str, write_policy_t *const policy) {
+    if (strcmp(str, "wb") == 0) {
+        *policy = WRITE_BACK;
+    } else if (strcmp(str, "wt") == 0) {
+        *policy = WRITE_THROUGH;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_write_miss(const char *const str, write_miss_t *const miss) {
+    if (strcmp(str, "wa") == 0) {
+        *miss = WRITE_ALLOCATE;
+    } else if (strcmp(str, "nwa") == 0) {
+        *miss = NO_WRITE_ALLOCATE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+void format_cache_mapping(const cache_config_t *const config, char *const buf,
+                          const size_t size) {
+    if (config->mapping == DIRECT_MAPPING) {
+        snprintf(buf, size, "dm");
+    } else if (config->mapping == FULLY_ASSOCIATIVE) {
+        snprintf(buf, size, "fa");
+    } else {
+        snprintf(buf, size, "sa%" PRIu32, config->ways);
+    }
+}
+
+const char *cache_policy_name(const cache_config_t *const config) {
+    if (config->mapping == DIRECT_MAPPING) {
+        return "-";
+    } else if (config->mapping == FULLY_ASSOCIATIVE) {
+        return policy_fifo.name;
+    }
+    return config->policy->name;
+}
+
+const char *cache_org_name(const cache_org_t org) {
+    return org == UNIFIED ? "uc" : "sc";
+}
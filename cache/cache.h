@@ -0,0 +1,145 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "addrsplit.h"
+#include "missclass.h"
+#include "policy.h"
+#include "prefetch.h"
+#include "simtypes.h"
+#include "tagscan.h"
+#include "trace.h"
+
+// Fully Associative caches with at most this many lines are searched with
+// SIMD tag comparisons instead of a hash index
+enum { FA_SCAN_MAX_LINES = 64 };
+// The largest number of ways in a Set Associative cache, so the replacement
+// policies can keep way numbers in a byte
+enum { MAX_WAYS = 256 };
+
+// The cache data structure. The cache lines are stored as a structure of
+// arrays, so the tags are packed together and can be compared several at a
+// time.
+typedef struct {
+    // The tag of each cache line, as a uint64_t if `wide_tags` is set and
+    // otherwise as a uint32_t
+    void *tags;
+    // Whether the tags need more than 32 bits
+    int wide_tags;
+    // A bitmap of whether each cache line contains valid data or not
+    uint64_t *valid;
+    // A bitmap of whether each cache line was written since it was filled
+    uint64_t *dirty;
+    // The number of cache lines
+    uintptr_t size;
+    // The FIFO queue of a Fully Associative cache, as a circular doubly linked
+    // list of the lines from the oldest to the newest. The head is filled
+    // next, and a line that is removed becomes the head, so freed lines are
+    // filled first and then join the back of the queue like any other fill.
+    uint32_t *fifo_next;
+    uint32_t *fifo_prev;
+    uintptr_t fifo_head;
+    // Hash index from tag to line when the cache is Fully Associative. Each
+    // entry is a line index plus one, or zero if the entry is empty.
+    uint32_t *tag_index;
+    // The number of entries in the tag index is 2^tag_index_bits
+    uint32_t tag_index_bits;
+    // Searches the lines of a small Fully Associative cache, or of a set in a
+    // Set Associative cache, for a tag of 32 or of 64 bits
+    tag_find_fn find_tag;
+    tag_find64_fn find_tag64;
+
+    // The number of ways in each set when the cache is Set Associative
+    uint32_t ways;
+    // The replacement policy when the cache is Set Associative
+    const replacement_policy_t *policy;
+    // The replacement policy state of each set
+    uint8_t *policy_state;
+    // The number of bytes of replacement policy state per set
+    size_t policy_state_size;
+
+    // Classifies the misses of the cache, or NULL if they are not classified
+    miss_classifier_t *classifier;
+    // The prefetch stage of the cache, or NULL if it does not prefetch
+    prefetch_unit_t *prefetch;
+} cache_t;
+
+// Context information for the cache(s)
+typedef struct {
+    // The instruction cache
+    cache_t *instr_cache;
+    // The data cache
+    cache_t *data_cache;
+    // The cache mapping
+    cache_map_t mapping;
+    // The cache organization
+    cache_org_t organization;
+
+    // Number of bits to use for the offset
+    uint32_t offset_bits;
+    // Number of bits to use for the index
+    uint32_t index_bits;
+    // Number of bits to use for the tag
+    uint32_t tag_bits;
+    // Splits the addresses of a batch into indexes and tags
+    addr_split_fn split_addresses;
+    // When stores reach the next level
+    write_policy_t write_policy;
+    // What a store that misses does
+    write_miss_t write_miss;
+} cache_context_t;
+
+// Creates the cache(s) for a valid configuration in `ctx`. Returns 0 on
+// success, or -1 if they cannot be allocated.
+int create_context(const cache_config_t *config, cache_context_t *ctx);
+
+// Frees the cache(s) of a context
+void destroy_context(const cache_context_t ctx);
+
+// Extracts the bits starting at `startBit` with length `len` and returns them
+// as an integer
+uint64_t extract_bits(const uint64_t val, const uint32_t startBit,
+                      const uint32_t len);
+
+// Perform a cache read using the given context, memory access, and statistics
+void cache_read(const cache_context_t ctx, const mem_access_t access,
+                cache_stat_t *const stat);
+
+// Performs the cache reads of `count` accesses. The addresses are split into
+// indexes and tags with SIMD instructions, and the statistics are updated once
+// for the whole batch.
+void cache_read_batch(const cache_context_t ctx, const mem_access_t *accesses,
+                      size_t count, cache_stat_t *stat);
+
+// Performs the cache reads of a batch like cache_read_batch, with the context
+// passed by reference
+typedef void (*cache_kernel_fn)(const cache_context_t *ctx,
+                                const mem_access_t *accesses, size_t count,
+                                cache_stat_t *stat);
+
+// Returns the kernel specialised for the mapping and organization of a
+// context. Select it once and call it for every batch; its inner loop has no
+// branches on the configuration.
+cache_kernel_fn cache_select_kernel(const cache_context_t *ctx);
+
+// Looks up the block of `access` without counting statistics. Returns 1 on a
+// hit, which updates the replacement state like a read, or 0 on a miss.
+int cache_probe(const cache_context_t ctx, const mem_access_t access);
+
+// Inserts the block of `access`, which must not be cached, without counting
+// statistics. Returns 1 and sets `victim` to the address of the evicted block
+// if a valid block was evicted, otherwise 0.
+int cache_fill(const cache_context_t ctx, const mem_access_t access,
+               uint64_t *victim);
+
+// Removes the block containing `address` from the cache(s) of a context.
+// Returns 1 if it was cached, otherwise 0.
+int cache_invalidate(const cache_context_t ctx, uint64_t address);
+
+// Removes the block of `access` from the cache of its type only. Returns 1 if
+// it was cached, otherwise 0.
+int cache_evict(const cache_context_t ctx, const mem_access_t access);
+
+#endif
@@ -0,0 +1,138 @@
+#include "cachesim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "prefilter.h"
+#include "shard.h"
+
+struct cachesim {
+    // The configuration, which the checkpoints are checked against
+    cache_config_t config;
+    cache_context_t ctx;
+    // The kernel specialised for the configuration
+    cache_kernel_fn read_batch;
+    cache_stat_t stat;
+    // The pre-filter in front of the cache, or NULL if there is none
+    prefilter_t *filter;
+    // The address bits above the address width, which must all be clear
+    uint64_t wide_mask;
+};
+
+// Returns whether every address of a batch fits in the address width of a
+// simulation. The kernels and the per-access path split wider addresses
+// differently, so they are never simulated.
+static int addresses_fit(const cachesim_t *const sim,
+                         const mem_access_t *const accesses,
+                         const size_t count) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < count; i++) {
+        bits |= accesses[i].address;
+    }
+    return (bits & sim->wide_mask) == 0;
+}
+
+// Returns whether the miss classifier of a cache ran out of memory
+static int classifier_failed(const cache_t *const cache) {
+    return cache != NULL && cache->classifier != NULL &&
+           cache->classifier->failed;
+}
+
+cachesim_t *cachesim_create(const cache_config_t *const config,
+                            const char **const error) {
+    *error = cache_config_error(config);
+    if (*error != NULL) {
+        return NULL;
+    }
+    cachesim_t *const sim = malloc(sizeof(cachesim_t));
+    if (sim == NULL) {
+        *error = "Unable to allocate the simulation";
+        return NULL;
+    }
+
+    sim->config = *config;
+    if (create_context(config, &sim->ctx) < 0) {
+        free(sim);
+        *error = "Unable to allocate the caches";
+        return NULL;
+    }
+    sim->read_batch = cache_select_kernel(&sim->ctx);
+    memset(&sim->stat, 0, sizeof(cache_stat_t));
+    sim->filter = NULL;
+    sim->wide_mask = config->address_bits >= MAX_ADDRESS_BITS
+                         ? 0
+                         : UINT64_MAX << config->address_bits;
+    return sim;
+}
+
+void cachesim_destroy(cachesim_t *const sim) {
+    destroy_context(sim->ctx);
+    free(sim->filter);
+    free(sim);
+}
+
+int cachesim_enable_prefilter(cachesim_t *const sim,
+                              const char **const error) {
+    *error = prefilter_config_error(&sim->config);
+    if (*error != NULL) {
+        return -1;
+    }
+    if (sim->filter == NULL) {
+        sim->filter = malloc(sizeof(prefilter_t));
+        if (sim->filter == NULL) {
+            *error = "Unable to allocate the pre-filter";
+            return -1;
+        }
+        prefilter_init(sim->filter, &sim->ctx);
+    }
+    return 0;
+}
+
+int cachesim_feed(cachesim_t *const sim, const mem_access_t *const accesses,
+                  const size_t count) {
+    if (!addresses_fit(sim, accesses, count)) {
+        return -1;
+    }
+    if (sim->filter == NULL) {
+        sim->read_batch(&sim->ctx, accesses, count, &sim->stat);
+    } else {
+        prefilter_read_batch(sim->filter, sim->read_batch, &sim->ctx,
+                             accesses, count, &sim->stat);
+    }
+    if (classifier_failed(sim->ctx.instr_cache) ||
+        classifier_failed(sim->ctx.data_cache)) {
+        return -1;
+    }
+    return 0;
+}
+
+int cachesim_feed_sharded(cachesim_t *const sim, mem_access_t *const accesses,
+                          size_t count, const unsigned threads) {
+    if (!addresses_fit(sim, accesses, count)) {
+        return -1;
+    }
+    // The pre-filter needs the accesses in trace order, so it runs on the
+    // whole trace before it is split
+    if (sim->filter != NULL) {
+        count =
+            prefilter_batch(sim->filter, accesses, count, accesses, &sim->stat);
+    }
+    return simulate_sharded(sim->ctx, accesses, count, threads, &sim->stat);
+}
+
+void cachesim_stats(const cachesim_t *const sim, cache_stat_t *const stat) {
+    *stat = sim->stat;
+}
+
+int cachesim_save(const cachesim_t *const sim, const char *const path,
+                  const trace_position_t position) {
+    return checkpoint_save(path, &sim->config, &sim->ctx, &sim->stat,
+                           position);
+}
+
+int cachesim_load(cachesim_t *const sim, const char *const path,
+                  trace_position_t *const position) {
+    return checkpoint_load(path, &sim->config, &sim->ctx, &sim->stat,
+                           position);
+}
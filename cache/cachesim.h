@@ -0,0 +1,62 @@
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stddef.h>
+
+#include "simtypes.h"
+
+// The simulator library: one handle per simulated cache configuration, so a
+// program can run many simulations in-process instead of one cache_sim
+// process each. Handles share no mutable state, so different threads can use
+// different handles at the same time; a single handle must not be used by two
+// threads at once.
+typedef struct cachesim cachesim_t;
+
+// Creates a simulation of `config` with empty caches and statistics. Returns
+// NULL and sets `error` to a description if the configuration cannot be
+// simulated or its memory cannot be allocated.
+cachesim_t *cachesim_create(const cache_config_t *config, const char **error);
+
+// Frees a simulation
+void cachesim_destroy(cachesim_t *sim);
+
+// Collapses repeated accesses to a block before they reach the cache from now
+// on (see prefilter.h), which gives the same statistics faster. Returns 0 on
+// success, or -1 and sets `error` to a description if the configuration
+// cannot be pre-filtered.
+int cachesim_enable_prefilter(cachesim_t *sim, const char **error);
+
+// Every address fed to a simulation must fit in the `address_bits` of its
+// configuration, like the addresses of a trace read with that width. A batch
+// with a wider address is rejected as a whole and nothing in it is simulated.
+
+// Simulates `count` accesses, which continue the accesses fed so far. Returns
+// 0 on success, or -1 if an address is too wide or the misses could no longer
+// be classified for lack of memory.
+int cachesim_feed(cachesim_t *sim, const mem_access_t *accesses, size_t count);
+
+// Simulates a whole trace on a Direct Mapped or Set Associative cache without
+// miss classification or prefetching, splitting the sets across `threads`
+// threads (see shard.h). The pre-filter, if enabled, compacts `accesses` in
+// place first. Returns 0 on success, or -1 if an address is too wide, the
+// memory could not be allocated or the threads could not be started.
+int cachesim_feed_sharded(cachesim_t *sim, mem_access_t *accesses,
+                          size_t count, unsigned threads);
+
+// Copies the statistics of the accesses fed so far to `stat`
+void cachesim_stats(const cachesim_t *sim, cache_stat_t *stat);
+
+// Writes a checkpoint of the simulation to `path` (see checkpoint.h), with
+// `position` as the place in the trace to resume from. Returns 0 on success,
+// or -1 on failure.
+int cachesim_save(const cachesim_t *sim, const char *path,
+                  trace_position_t position);
+
+// Restores a simulation that was not fed yet from the checkpoint at `path` and
+// sets `position` to the place in the trace to resume from. Returns 0 on
+// success, or -1 if the checkpoint cannot be read or was written for a
+// different configuration.
+int cachesim_load(cachesim_t *sim, const char *path,
+                  trace_position_t *position);
+
+#endif
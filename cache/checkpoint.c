@@ -0,0 +1,402 @@
+#define _DEFAULT_SOURCE
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Written after the version, so a checkpoint from a host with another byte
+// order is rejected
+enum { BYTE_ORDER_MARK = 0x01020304 };
+// The size of the replacement policy and prefetcher names in a checkpoint
+enum { POLICY_NAME_SIZE = 16 };
+
+// A cache configuration as it is stored in a checkpoint
+typedef struct {
+    // The total cache size in bytes
+    uint32_t size;
+    // The cache mapping
+    uint32_t mapping;
+    // The cache organization
+    uint32_t organization;
+    // The number of ways in each set when the mapping is Set Associative
+    uint32_t ways;
+    // The size of a block in bytes
+    uint32_t block_size;
+    // The number of address bits
+    uint32_t address_bits;
+    // Whether misses are classified
+    uint32_t classify_misses;
+    // When stores reach the next level
+    uint32_t write_policy;
+    // What a store that misses does
+    uint32_t write_miss;
+    // How far ahead the prefetcher fetches, and how long its prefetches take
+    uint32_t prefetch_degree;
+    uint32_t prefetch_latency;
+    // The name of the replacement policy, padded with zeros
+    char policy[POLICY_NAME_SIZE];
+    // The name of the prefetcher, or zeros if there is none
+    char prefetcher[POLICY_NAME_SIZE];
+} stored_config_t;
+
+// Converts a configuration to the way it is stored
+static void store_config(const cache_config_t *const config,
+                         stored_config_t *const stored) {
+    memset(stored, 0, sizeof(stored_config_t));
+    stored->size = config->size;
+    stored->mapping = (uint32_t)config->mapping;
+    stored->organization = (uint32_t)config->organization;
+    stored->ways = config->mapping == SET_ASSOCIATIVE ? config->ways : 0;
+    stored->block_size = config->block_size;
+    stored->address_bits = config->address_bits;
+    stored->classify_misses = config->classify_misses != 0;
+    stored->write_policy = (uint32_t)config->write_policy;
+    stored->write_miss = (uint32_t)config->write_miss;
+    strncpy(stored->policy, cache_policy_name(config), POLICY_NAME_SIZE - 1);
+    if (config->prefetcher != NULL) {
+        stored->prefetch_degree = config->prefetch_degree;
+        stored->prefetch_latency = config->prefetch_latency;
+        strncpy(stored->prefetcher, config->prefetcher->name,
+                POLICY_NAME_SIZE - 1);
+    }
+}
+
+// Writes `size` bytes. Returns 0 on success, or -1 on failure.
+static int write_bytes(FILE *const file, const void *const data,
+                       const size_t size) {
+    return size == 0 || fwrite(data, size, 1, file) == 1 ? 0 : -1;
+}
+
+// Reads `size` bytes. Returns 0 on success, or -1 if the file is too short.
+static int read_bytes(FILE *const file, void *const data, const size_t size) {
+    return size == 0 || fread(data, size, 1, file) == 1 ? 0 : -1;
+}
+
+// Returns the number of bytes of replacement policy state of a cache
+static size_t policy_state_bytes(const cache_t *const cache) {
+    if (cache->policy_state == NULL) {
+        return 0;
+    }
+    return cache->size / cache->ways * cache->policy_state_size;
+}
+
+// Returns the number of bytes of tags of a cache
+static size_t tag_bytes(const cache_t *const cache) {
+    return cache->size *
+           (cache->wide_tags ? sizeof(uint64_t) : sizeof(uint32_t));
+}
+
+// Returns the number of lines in the FIFO queue of a cache, which only Fully
+// Associative caches have
+static size_t fifo_entries(const cache_t *const cache) {
+    return cache->fifo_next == NULL ? 0 : cache->size;
+}
+
+// Returns whether the FIFO queue of a cache is a valid circular list of its
+// lines
+static int fifo_valid(const cache_t *const cache) {
+    const size_t lines = fifo_entries(cache);
+    if (lines == 0) {
+        return 1;
+    }
+    if (cache->fifo_head >= lines) {
+        return 0;
+    }
+    for (size_t i = 0; i < lines; i++) {
+        if (cache->fifo_next[i] >= lines || cache->fifo_prev[i] >= lines ||
+            cache->fifo_prev[cache->fifo_next[i]] != i) {
+            return 0;
+        }
+    }
+    // The links are consistent, so the list is one cycle if it only returns
+    // to the head after visiting every line
+    size_t length = 1;
+    for (uint32_t i = cache->fifo_next[cache->fifo_head];
+         i != cache->fifo_head; i = cache->fifo_next[i]) {
+        length++;
+    }
+    return length == lines;
+}
+
+// Returns the number of entries in the tag index of a cache
+static size_t tag_index_entries(const cache_t *const cache) {
+    if (cache->tag_index == NULL) {
+        return 0;
+    }
+    return (size_t)1 << cache->tag_index_bits;
+}
+
+// Writes the state of a miss classifier
+static int save_classifier(FILE *const file,
+                           const miss_classifier_t *const classifier) {
+    const uint64_t map[2] = {classifier->map_capacity, classifier->map_count};
+    const uint32_t list[3] = {classifier->used, classifier->head,
+                              classifier->tail};
+    const size_t lines = classifier->capacity;
+
+    if (write_bytes(file, map, sizeof(map)) < 0 ||
+        write_bytes(file, classifier->keys,
+                    classifier->map_capacity * sizeof(uint64_t)) < 0 ||
+        write_bytes(file, classifier->lines,
+                    classifier->map_capacity * sizeof(uint32_t)) < 0 ||
+        write_bytes(file, list, sizeof(list)) < 0 ||
+        write_bytes(file, classifier->blocks, lines * sizeof(uint64_t)) < 0 ||
+        write_bytes(file, classifier->prev, lines * sizeof(uint32_t)) < 0 ||
+        write_bytes(file, classifier->next, lines * sizeof(uint32_t)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Reads the state of a miss classifier with as many shadow lines as the one
+// that was saved
+static int load_classifier(FILE *const file,
+                           miss_classifier_t *const classifier) {
+    uint64_t map[2];
+    uint32_t list[3];
+    const size_t lines = classifier->capacity;
+
+    if (read_bytes(file, map, sizeof(map)) < 0 || map[0] == 0 ||
+        (map[0] & (map[0] - 1)) != 0 || map[1] >= map[0] ||
+        map[0] > SIZE_MAX / sizeof(uint64_t)) {
+        return -1;
+    }
+
+    // The hash map grows during a run, so it is reallocated at its saved size
+    free(classifier->keys);
+    free(classifier->lines);
+    classifier->map_capacity = (size_t)map[0];
+    classifier->map_count = (size_t)map[1];
+    classifier->keys = malloc(classifier->map_capacity * sizeof(uint64_t));
+    classifier->lines = malloc(classifier->map_capacity * sizeof(uint32_t));
+    if (classifier->keys == NULL || classifier->lines == NULL) {
+        return -1;
+    }
+
+    if (read_bytes(file, classifier->keys,
+                   classifier->map_capacity * sizeof(uint64_t)) < 0 ||
+        read_bytes(file, classifier->lines,
+                   classifier->map_capacity * sizeof(uint32_t)) < 0 ||
+        read_bytes(file, list, sizeof(list)) < 0 || list[0] > lines ||
+        read_bytes(file, classifier->blocks, lines * sizeof(uint64_t)) < 0 ||
+        read_bytes(file, classifier->prev, lines * sizeof(uint32_t)) < 0 ||
+        read_bytes(file, classifier->next, lines * sizeof(uint32_t)) < 0) {
+        return -1;
+    }
+    // The list is empty until the first shadow line is used, and then its
+    // head and tail are shadow lines in use
+    if (list[0] == 0 ? list[1] != MISS_NO_LINE || list[2] != MISS_NO_LINE
+                     : list[1] >= list[0] || list[2] >= list[0]) {
+        return -1;
+    }
+    classifier->used = list[0];
+    classifier->head = list[1];
+    classifier->tail = list[2];
+    return 0;
+}
+
+// Writes the state of a prefetch stage. Its counts are added to the
+// statistics after every batch, so they are always zero here.
+static int save_prefetch(FILE *const file,
+                         const prefetch_unit_t *const unit,
+                         const size_t lines) {
+    if (write_bytes(file, &unit->clock, sizeof(unit->clock)) < 0 ||
+        write_bytes(file, unit->prefetched_at, lines * sizeof(uint64_t)) < 0 ||
+        write_bytes(file, unit->filter,
+                    prefetch_filter_entries(unit) * sizeof(uint64_t)) < 0 ||
+        write_bytes(file, unit->state, prefetch_state_bytes(unit)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Reads the state of a prefetch stage
+static int load_prefetch(FILE *const file, prefetch_unit_t *const unit,
+                         const size_t lines) {
+    if (read_bytes(file, &unit->clock, sizeof(unit->clock)) < 0 ||
+        read_bytes(file, unit->prefetched_at, lines * sizeof(uint64_t)) < 0 ||
+        read_bytes(file, unit->filter,
+                   prefetch_filter_entries(unit) * sizeof(uint64_t)) < 0 ||
+        read_bytes(file, unit->state, prefetch_state_bytes(unit)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Writes the state of a cache
+static int save_cache(FILE *const file, const cache_t *const cache) {
+    const uint64_t fifo_head = cache->fifo_head;
+    const size_t valid_words = (cache->size + 63) / 64;
+
+    if (write_bytes(file, &fifo_head, sizeof(fifo_head)) < 0 ||
+        write_bytes(file, cache->fifo_next,
+                    fifo_entries(cache) * sizeof(uint32_t)) < 0 ||
+        write_bytes(file, cache->fifo_prev,
+                    fifo_entries(cache) * sizeof(uint32_t)) < 0 ||
+        write_bytes(file, cache->tags, tag_bytes(cache)) < 0 ||
+        write_bytes(file, cache->valid, valid_words * sizeof(uint64_t)) < 0 ||
+        write_bytes(file, cache->dirty, valid_words * sizeof(uint64_t)) < 0 ||
+        write_bytes(file, cache->tag_index,
+                    tag_index_entries(cache) * sizeof(uint32_t)) < 0 ||
+        write_bytes(file, cache->policy_state, policy_state_bytes(cache)) <
+            0) {
+        return -1;
+    }
+    if (cache->classifier != NULL &&
+        save_classifier(file, cache->classifier) < 0) {
+        return -1;
+    }
+    if (cache->prefetch != NULL) {
+        return save_prefetch(file, cache->prefetch, cache->size);
+    }
+    return 0;
+}
+
+// Reads the state of a cache created from the configuration it was saved with
+static int load_cache(FILE *const file, cache_t *const cache) {
+    uint64_t fifo_head;
+    const size_t valid_words = (cache->size + 63) / 64;
+
+    if (read_bytes(file, &fifo_head, sizeof(fifo_head)) < 0 ||
+        fifo_head >= cache->size ||
+        read_bytes(file, cache->fifo_next,
+                   fifo_entries(cache) * sizeof(uint32_t)) < 0 ||
+        read_bytes(file, cache->fifo_prev,
+                   fifo_entries(cache) * sizeof(uint32_t)) < 0 ||
+        read_bytes(file, cache->tags, tag_bytes(cache)) < 0 ||
+        read_bytes(file, cache->valid, valid_words * sizeof(uint64_t)) < 0 ||
+        read_bytes(file, cache->dirty, valid_words * sizeof(uint64_t)) < 0 ||
+        read_bytes(file, cache->tag_index,
+                   tag_index_entries(cache) * sizeof(uint32_t)) < 0 ||
+        read_bytes(file, cache->policy_state, policy_state_bytes(cache)) < 0) {
+        return -1;
+    }
+    cache->fifo_head = (uintptr_t)fifo_head;
+    if (!fifo_valid(cache)) {
+        return -1;
+    }
+    if (cache->classifier != NULL &&
+        load_classifier(file, cache->classifier) < 0) {
+        return -1;
+    }
+    if (cache->prefetch != NULL) {
+        return load_prefetch(file, cache->prefetch, cache->size);
+    }
+    return 0;
+}
+
+// Writes everything before the caches
+static int save_header(FILE *const file, const cache_config_t *const config,
+                       const cache_stat_t *const stat,
+                       const trace_position_t position) {
+    const uint32_t header[3] = {CHECKPOINT_VERSION, BYTE_ORDER_MARK,
+                                sizeof(cache_stat_t)};
+    stored_config_t stored;
+    store_config(config, &stored);
+
+    if (write_bytes(file, CHECKPOINT_MAGIC, 4) < 0 ||
+        write_bytes(file, header, sizeof(header)) < 0 ||
+        write_bytes(file, &stored, sizeof(stored)) < 0 ||
+        write_bytes(file, stat, sizeof(cache_stat_t)) < 0 ||
+        write_bytes(file, &position.offset, sizeof(position.offset)) < 0 ||
+        write_bytes(file, &position.skip, sizeof(position.skip)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Reads everything before the caches and checks that the checkpoint was
+// written for `config`
+static int load_header(FILE *const file, const cache_config_t *const config,
+                       cache_stat_t *const stat,
+                       trace_position_t *const position) {
+    char magic[4];
+    uint32_t header[3];
+    stored_config_t stored;
+    stored_config_t expected;
+    store_config(config, &expected);
+
+    if (read_bytes(file, magic, sizeof(magic)) < 0 ||
+        memcmp(magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        read_bytes(file, header, sizeof(header)) < 0 ||
+        header[0] != CHECKPOINT_VERSION || header[1] != BYTE_ORDER_MARK ||
+        header[2] != sizeof(cache_stat_t) ||
+        read_bytes(file, &stored, sizeof(stored)) < 0 ||
+        memcmp(&stored, &expected, sizeof(stored_config_t)) != 0 ||
+        read_bytes(file, stat, sizeof(cache_stat_t)) < 0 ||
+        read_bytes(file, &position->offset, sizeof(position->offset)) < 0 ||
+        read_bytes(file, &position->skip, sizeof(position->skip)) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int checkpoint_save(const char *const path, const cache_config_t *const config,
+                    const cache_context_t *const ctx,
+                    const cache_stat_t *const stat,
+                    const trace_position_t position) {
+    // The temporary file is next to the checkpoint, so the rename stays on
+    // one file system and replaces the checkpoint atomically
+    const size_t length = strlen(path);
+    char *const temp_path = malloc(length + sizeof(".tmp"));
+    if (temp_path == NULL) {
+        return -1;
+    }
+    memcpy(temp_path, path, length);
+    memcpy(temp_path + length, ".tmp", sizeof(".tmp"));
+
+    FILE *const file = fopen(temp_path, "wb");
+    if (file == NULL) {
+        free(temp_path);
+        return -1;
+    }
+
+    int result = 0;
+    if (save_header(file, config, stat, position) < 0 ||
+        save_cache(file, ctx->instr_cache) < 0 ||
+        (ctx->organization == SPLIT && save_cache(file, ctx->data_cache) < 0)) {
+        result = -1;
+    }
+    // The data must be on disk before the rename makes it the checkpoint
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        result = -1;
+    }
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+    if (result == 0 && rename(temp_path, path) != 0) {
+        result = -1;
+    }
+    if (result < 0) {
+        unlink(temp_path);
+    }
+
+    free(temp_path);
+    return result;
+}
+
+int checkpoint_load(const char *const path, const cache_config_t *const config,
+                    cache_context_t *const ctx, cache_stat_t *const stat,
+                    trace_position_t *const position) {
+    FILE *const file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    int result = 0;
+    if (load_header(file, config, stat, position) < 0 ||
+        load_cache(file, ctx->instr_cache) < 0 ||
+        (ctx->organization == SPLIT && load_cache(file, ctx->data_cache) < 0)) {
+        result = -1;
+    }
+    // Anything after the caches means the file is not what it claims to be
+    if (result == 0 && fgetc(file) != EOF) {
+        result = -1;
+    }
+
+    fclose(file);
+    return result;
+}
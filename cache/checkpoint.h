@@ -0,0 +1,40 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "cache.h"
+#include "trace.h"
+
+// The magic bytes at the start of a checkpoint file
+#define CHECKPOINT_MAGIC "CCKP"
+// The version of the checkpoint format
+enum { CHECKPOINT_VERSION = 5 };
+
+// Checkpoints hold the whole state of a single cache simulation, so a long run
+// can be resumed where it stopped and give the same results as an
+// uninterrupted one.
+//
+// The file starts with CHECKPOINT_MAGIC, the format version, a byte order mark
+// and the size of cache_stat_t, followed by the cache configuration, the
+// statistics and the trace position to resume from. Then come the FIFO queue,
+// the lines with their tags (32 or 64 bits, as the cache stores them) and
+// their valid and dirty bits, the tag index, the replacement policy state, the
+// miss classifier and the prefetch stage of each cache.
+// Integers and arrays are written in the byte order of the host, so a
+// checkpoint is only read back on the same kind of machine.
+
+// Writes the state of a simulation of `config` to `path`. The file is written
+// next to `path` first and then renamed over it, so an interrupted write never
+// leaves a partial checkpoint. Returns 0 on success, or -1 on failure.
+int checkpoint_save(const char *path, const cache_config_t *config,
+                    const cache_context_t *ctx, const cache_stat_t *stat,
+                    trace_position_t position);
+
+// Restores the state of a simulation of `config` from `path` into `ctx`, which
+// must be newly created from `config`, and sets `stat` and `position`. Returns
+// 0 on success, or -1 if the file cannot be read, is corrupt or was written
+// for a different configuration.
+int checkpoint_load(const char *path, const cache_config_t *config,
+                    cache_context_t *ctx, cache_stat_t *stat,
+                    trace_position_t *position);
+
+#endif
@@ -0,0 +1,554 @@
+#define _DEFAULT_SOURCE
+
+#include "coherence.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The initial number of entries of a state map
+enum { INITIAL_CAPACITY = 1 << 10 };
+// The number of accesses decoded at a time from the trace of a core
+enum { CORE_BATCH_SIZE = 4096 };
+
+// The state of a block in one cache. The valid states come last, so a block
+// is cached if its state is at least MESI_SHARED.
+typedef enum {
+    // The block is not cached
+    MESI_INVALID,
+    // The block is not cached because another core wrote it, so the next miss
+    // on it is a coherence miss
+    MESI_INVALIDATED,
+    // The block is cached and may be cached elsewhere too
+    MESI_SHARED,
+    // The block is only cached here and is clean
+    MESI_EXCLUSIVE,
+    // The block is only cached here and was written
+    MESI_MODIFIED,
+} mesi_state_t;
+
+// Open addressing hash map from the blocks (plus one) of a cache to their
+// state. Blocks that are not cached and were never invalidated are left out.
+typedef struct {
+    uint64_t *keys;
+    uint8_t *states;
+    // The size of the map, a power of two
+    size_t capacity;
+    // The number of blocks in the map
+    size_t count;
+} state_map_t;
+
+// One core and its private caches
+typedef struct {
+    cache_context_t ctx;
+    // The states of the blocks of the instruction and data caches, which are
+    // the same map when the caches are unified
+    state_map_t maps[2];
+    // The trace of the core and the accesses decoded from it
+    trace_reader_t *trace;
+    mem_access_t *batch;
+    size_t batch_count;
+    // The next access to simulate in `batch`
+    size_t batch_next;
+    // Why decoding stopped after `batch`
+    trace_status_t status;
+    // Whether the next access waits for the bus
+    int pending;
+    // Whether every access of the trace was simulated
+    int finished;
+    // The statistics of the core
+    cache_stat_t stat;
+    coherence_stat_t coherence;
+} core_t;
+
+// The state shared by the threads of a simulation
+typedef struct {
+    core_t *cores;
+    size_t core_count;
+    cache_org_t organization;
+    uint32_t offset_bits;
+    // The number of threads, which is only known for sure once every thread
+    // was started
+    unsigned threads;
+    // Held while the threads are started, so none runs before `threads` and
+    // `barrier` are set
+    pthread_mutex_t start;
+    // Separates the local phase from the bus phase
+    pthread_barrier_t barrier;
+    // Set in the bus phase once every core is finished, or once a state map
+    // could not grow
+    int done;
+    // Set in the bus phase if a state map could not grow
+    int failed;
+} system_t;
+
+// The state of one worker thread
+typedef struct {
+    system_t *system;
+    unsigned index;
+} worker_t;
+
+// Returns the index of `key` in a state map, or of the empty entry where it
+// would be inserted
+static size_t map_find(const state_map_t *const map, const uint64_t key) {
+    const size_t mask = map->capacity - 1;
+    size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+    while (map->keys[i] != 0 && map->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Initializes an empty state map. Returns 0 on success, or -1 if its memory
+// cannot be allocated, which map_free() still releases.
+static int map_init(state_map_t *const map) {
+    map->capacity = INITIAL_CAPACITY;
+    map->count = 0;
+    map->keys = calloc(map->capacity, sizeof(uint64_t));
+    map->states = malloc(map->capacity);
+    return map->keys == NULL || map->states == NULL ? -1 : 0;
+}
+
+static void map_free(state_map_t *const map) {
+    free(map->keys);
+    free(map->states);
+}
+
+// Doubles the size of a state map. Returns 0 on success, or -1 if the larger
+// map cannot be allocated, in which case the old one is kept.
+static int map_grow(state_map_t *const map) {
+    uint64_t *const old_keys = map->keys;
+    uint8_t *const old_states = map->states;
+    const size_t old_capacity = map->capacity;
+
+    uint64_t *const keys = calloc(2 * old_capacity, sizeof(uint64_t));
+    uint8_t *const states = malloc(2 * old_capacity);
+    if (keys == NULL || states == NULL) {
+        free(keys);
+        free(states);
+        return -1;
+    }
+    map->capacity = 2 * old_capacity;
+    map->keys = keys;
+    map->states = states;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != 0) {
+            const size_t j = map_find(map, old_keys[i]);
+            map->keys[j] = old_keys[i];
+            map->states[j] = old_states[i];
+        }
+    }
+
+    free(old_keys);
+    free(old_states);
+    return 0;
+}
+
+// Returns the state of `block` in a cache
+static mesi_state_t map_get(const state_map_t *const map,
+                            const uint64_t block) {
+    const size_t i = map_find(map, block + 1);
+    return map->keys[i] == 0 ? MESI_INVALID : (mesi_state_t)map->states[i];
+}
+
+// Sets the state of `block` in a cache. Returns 0 on success, or -1 if the
+// block is new and the map cannot grow to hold it. Blocks that are already in
+// the map never fail.
+static int map_set(state_map_t *const map, const uint64_t block,
+                   const mesi_state_t state) {
+    size_t i = map_find(map, block + 1);
+    if (map->keys[i] == 0) {
+        // Keep the map at most half full so probe sequences stay short
+        if (2 * (map->count + 1) > map->capacity) {
+            if (map_grow(map) < 0) {
+                return -1;
+            }
+            i = map_find(map, block + 1);
+        }
+        map->keys[i] = block + 1;
+        map->count++;
+    }
+    map->states[i] = (uint8_t)state;
+    return 0;
+}
+
+// Removes `block` from a state map and shifts the following entries of the
+// probe sequence back, so lookups never need tombstones
+static void map_remove(state_map_t *const map, const uint64_t block) {
+    const size_t mask = map->capacity - 1;
+    size_t i = map_find(map, block + 1);
+    if (map->keys[i] == 0) {
+        return;
+    }
+    size_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        const uint64_t key = map->keys[j];
+        if (key == 0) {
+            break;
+        }
+        // An entry can move back to `i` only if that does not put it before
+        // its home entry
+        const size_t home =
+            (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            map->keys[i] = key;
+            map->states[i] = map->states[j];
+            i = j;
+        }
+    }
+    map->keys[i] = 0;
+    map->count--;
+}
+
+// Returns the number of distinct caches, and so of state maps, of a core
+static size_t cache_count(const system_t *const system) {
+    return system->organization == SPLIT ? 2 : 1;
+}
+
+// Returns the state map of the cache of a core that holds the accesses of
+// type `type`
+static state_map_t *map_for(const system_t *const system, core_t *const core,
+                            const access_t type) {
+    return &core->maps[system->organization == SPLIT ? type : 0];
+}
+
+// Returns the next access of a core, decoding more of its trace if needed, or
+// NULL and marks the core finished at the end of its trace
+static const mem_access_t *next_access(core_t *const core) {
+    if (core->batch_next == core->batch_count) {
+        if (core->status != TRACE_OK) {
+            core->finished = 1;
+            return NULL;
+        }
+        core->batch_count = trace_read_batch(core->trace, core->batch,
+                                             CORE_BATCH_SIZE, &core->status);
+        core->batch_next = 0;
+        if (core->batch_count == 0) {
+            core->finished = 1;
+            return NULL;
+        }
+    }
+    return &core->batch[core->batch_next];
+}
+
+// Counts a simulated access of a core and moves on to the next one
+static void count_access(core_t *const core, const mem_access_t *const access,
+                         const int hit) {
+    cache_stat_t *const stat = &core->stat;
+    stat->accesses++;
+    stat->hits += (uint64_t)hit;
+    if (access->accessType == INSTRUCTION) {
+        stat->instr_accesses++;
+        stat->instr_hits += (uint64_t)hit;
+    } else {
+        stat->data_accesses++;
+        stat->data_hits += (uint64_t)hit;
+    }
+    stat->writes += access->isWrite;
+    core->batch_next++;
+}
+
+// Counts the writeback of a Modified block by a core
+static void count_writeback(const system_t *const system, core_t *const core) {
+    core->coherence.bus_writebacks++;
+    core->stat.writebacks++;
+    core->stat.bytes_written += (uint64_t)1 << system->offset_bits;
+}
+
+// Simulates the accesses of a core until one of them needs the bus or the
+// quantum is used up. Only the core itself is touched, so the cores can run
+// this in parallel.
+static void run_local(const system_t *const system, core_t *const core) {
+    for (uint32_t i = 0; i < COHERENCE_QUANTUM; i++) {
+        const mem_access_t *const access = next_access(core);
+        if (access == NULL) {
+            return;
+        }
+        state_map_t *const map = map_for(system, core, access->accessType);
+        const uint64_t block = access->address >> system->offset_bits;
+        const mesi_state_t state = map_get(map, block);
+        if (state < MESI_SHARED ||
+            (access->isWrite && state == MESI_SHARED)) {
+            core->pending = 1;
+            return;
+        }
+
+        // Only the replacement state changes on a hit
+        cache_probe(core->ctx, *access);
+        if (access->isWrite && state == MESI_EXCLUSIVE) {
+            map_set(map, block, MESI_MODIFIED);
+        }
+        count_access(core, access, 1);
+    }
+}
+
+// Invalidates `block` in every cache but the one of `map`, writing it back
+// from the cache that has it Modified
+static void invalidate_others(const system_t *const system,
+                              const state_map_t *const map,
+                              const uint64_t block) {
+    for (size_t c = 0; c < system->core_count; c++) {
+        core_t *const other = &system->cores[c];
+        for (size_t type = 0; type < cache_count(system); type++) {
+            state_map_t *const other_map = &other->maps[type];
+            const mesi_state_t state =
+                other_map == map ? MESI_INVALID : map_get(other_map, block);
+            if (state < MESI_SHARED) {
+                continue;
+            }
+            if (state == MESI_MODIFIED) {
+                count_writeback(system, other);
+            }
+            cache_evict(other->ctx,
+                        (mem_access_t){.address = block << system->offset_bits,
+                                       .accessType = (uint8_t)type});
+            map_set(other_map, block, MESI_INVALIDATED);
+            other->coherence.invalidations++;
+        }
+    }
+}
+
+// Makes `block` Shared in every cache but the one of `map` that holds it,
+// writing it back from the cache that has it Modified. Returns whether any
+// other cache holds it.
+static int share_others(const system_t *const system,
+                        const state_map_t *const map, const uint64_t block) {
+    int shared = 0;
+    for (size_t c = 0; c < system->core_count; c++) {
+        core_t *const other = &system->cores[c];
+        for (size_t type = 0; type < cache_count(system); type++) {
+            state_map_t *const other_map = &other->maps[type];
+            const mesi_state_t state =
+                other_map == map ? MESI_INVALID : map_get(other_map, block);
+            if (state < MESI_SHARED) {
+                continue;
+            }
+            if (state == MESI_MODIFIED) {
+                count_writeback(system, other);
+            }
+            if (state != MESI_SHARED) {
+                map_set(other_map, block, MESI_SHARED);
+            }
+            shared = 1;
+        }
+    }
+    return shared;
+}
+
+// Broadcasts the waiting access of a core on the bus and simulates it. Other
+// cores are touched too, so this only runs in the bus phase. Returns 0 on
+// success, or -1 if the state map of the core cannot hold the filled block.
+static int run_bus(const system_t *const system, core_t *const core) {
+    const mem_access_t *const access = &core->batch[core->batch_next];
+    state_map_t *const map = map_for(system, core, access->accessType);
+    const uint64_t block = access->address >> system->offset_bits;
+    const mesi_state_t state = map_get(map, block);
+    core->pending = 0;
+
+    if (state >= MESI_SHARED) {
+        // Only writes of Shared blocks wait for the bus while they hit
+        core->coherence.bus_upgrades++;
+        invalidate_others(system, map, block);
+        cache_probe(core->ctx, *access);
+        map_set(map, block, MESI_MODIFIED);
+        count_access(core, access, 1);
+        return 0;
+    }
+
+    if (state == MESI_INVALIDATED) {
+        core->coherence.coherence_misses++;
+    }
+    mesi_state_t filled;
+    if (access->isWrite) {
+        core->coherence.bus_read_exclusives++;
+        invalidate_others(system, map, block);
+        filled = MESI_MODIFIED;
+    } else {
+        core->coherence.bus_reads++;
+        filled = share_others(system, map, block) ? MESI_SHARED
+                                                  : MESI_EXCLUSIVE;
+    }
+    core->stat.bytes_read += (uint64_t)1 << system->offset_bits;
+
+    // The victim comes from the same cache as the block
+    uint64_t victim;
+    if (cache_fill(core->ctx, *access, &victim)) {
+        const uint64_t victim_block = victim >> system->offset_bits;
+        if (map_get(map, victim_block) == MESI_MODIFIED) {
+            count_writeback(system, core);
+        }
+        map_remove(map, victim_block);
+    }
+    if (map_set(map, block, filled) < 0) {
+        return -1;
+    }
+    count_access(core, access, 0);
+    return 0;
+}
+
+static void *worker_main(void *const arg) {
+    const worker_t *const worker = arg;
+    system_t *const system = worker->system;
+
+    // Wait until every thread was started
+    pthread_mutex_lock(&system->start);
+    pthread_mutex_unlock(&system->start);
+
+    // Each thread runs the local phases of an equal share of the cores
+    const size_t begin =
+        system->core_count * worker->index / system->threads;
+    const size_t end =
+        system->core_count * (worker->index + 1) / system->threads;
+
+    while (1) {
+        for (size_t c = begin; c < end; c++) {
+            if (!system->cores[c].finished) {
+                run_local(system, &system->cores[c]);
+            }
+        }
+
+        // One thread runs the bus phase while the others wait
+        if (pthread_barrier_wait(&system->barrier) ==
+            PTHREAD_BARRIER_SERIAL_THREAD) {
+            int done = 1;
+            for (size_t c = 0; c < system->core_count && !system->failed;
+                 c++) {
+                core_t *const core = &system->cores[c];
+                if (core->pending && run_bus(system, core) < 0) {
+                    system->failed = 1;
+                }
+                done &= core->finished;
+            }
+            system->done = done || system->failed;
+        }
+        pthread_barrier_wait(&system->barrier);
+        if (system->done) {
+            return NULL;
+        }
+    }
+}
+
+// Frees the caches, maps and batches of the first `count` cores and the cores
+static void free_cores(core_t *const cores, const size_t count,
+                       const cache_org_t organization) {
+    for (size_t c = 0; c < count; c++) {
+        destroy_context(cores[c].ctx);
+        map_free(&cores[c].maps[0]);
+        if (organization == SPLIT) {
+            map_free(&cores[c].maps[1]);
+        }
+        free(cores[c].batch);
+    }
+    free(cores);
+}
+
+int simulate_coherent(const cache_config_t *const config,
+                      trace_reader_t *const traces, const size_t cores,
+                      unsigned threads, cache_stat_t *const stats,
+                      coherence_stat_t *const coherence,
+                      trace_status_t *const status) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > cores) {
+        threads = (unsigned)cores;
+    }
+
+    system_t system = {.core_count = cores,
+                       .organization = config->organization,
+                       .done = 0,
+                       .failed = 0};
+    system.cores = calloc(cores, sizeof(core_t));
+    if (system.cores == NULL) {
+        return -1;
+    }
+    for (size_t c = 0; c < cores; c++) {
+        core_t *const core = &system.cores[c];
+        if (create_context(config, &core->ctx) < 0) {
+            free_cores(system.cores, c, config->organization);
+            return -1;
+        }
+        core->trace = &traces[c];
+        core->batch = malloc(CORE_BATCH_SIZE * sizeof(mem_access_t));
+        core->status = TRACE_OK;
+        // The context of the core was created, so free_cores() releases
+        // whatever was allocated here
+        if (map_init(&core->maps[0]) < 0 ||
+            (config->organization == SPLIT && map_init(&core->maps[1]) < 0) ||
+            core->batch == NULL) {
+            free_cores(system.cores, c + 1, config->organization);
+            return -1;
+        }
+    }
+    system.offset_bits = system.cores[0].ctx.offset_bits;
+
+    worker_t *const workers = calloc(threads, sizeof(worker_t));
+    pthread_t *const handles = calloc(threads, sizeof(pthread_t));
+    if (workers == NULL || handles == NULL) {
+        free_cores(system.cores, cores, config->organization);
+        free(workers);
+        free(handles);
+        return -1;
+    }
+    pthread_mutex_init(&system.start, NULL);
+    pthread_mutex_lock(&system.start);
+
+    // The calling thread is worker 0. If a thread cannot be started, the
+    // cores are shared between the ones that were, which only makes the run
+    // slower.
+    unsigned started = 1;
+    for (; started < threads; started++) {
+        workers[started] = (worker_t){.system = &system, .index = started};
+        if (pthread_create(&handles[started], NULL, worker_main,
+                           &workers[started]) != 0) {
+            break;
+        }
+    }
+    system.threads = started;
+    pthread_barrier_init(&system.barrier, NULL, started);
+    pthread_mutex_unlock(&system.start);
+
+    workers[0] = (worker_t){.system = &system, .index = 0};
+    worker_main(&workers[0]);
+    for (unsigned i = 1; i < started; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    pthread_barrier_destroy(&system.barrier);
+    pthread_mutex_destroy(&system.start);
+
+    *status = TRACE_END;
+    for (size_t c = 0; c < cores; c++) {
+        core_t *const core = &system.cores[c];
+        stats[c] = core->stat;
+        coherence[c] = core->coherence;
+        if (*status == TRACE_END && core->status != TRACE_END) {
+            *status = core->status;
+        }
+    }
+
+    free_cores(system.cores, cores, config->organization);
+    free(workers);
+    free(handles);
+
+    return system.failed ? -1 : 0;
+}
+
+const char *coherence_config_error(const cache_config_t *const config) {
+    if (config->write_policy != WRITE_BACK ||
+        config->write_miss != WRITE_ALLOCATE) {
+        return "Coherent caches are write-back and write-allocate";
+    }
+    if (config->prefetcher != NULL) {
+        return "Coherent caches cannot prefetch";
+    }
+    if (config->classify_misses) {
+        return "The misses of coherent caches cannot be classified";
+    }
+    return NULL;
+}
+
+uint64_t coherence_bus_transactions(const coherence_stat_t *const stat) {
+    return stat->bus_reads + stat->bus_read_exclusives + stat->bus_upgrades +
+           stat->bus_writebacks;
+}
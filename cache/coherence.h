@@ -0,0 +1,61 @@
+#ifndef COHERENCE_H
+#define COHERENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "trace.h"
+
+// The largest number of cores of a coherent simulation
+enum { COHERENCE_MAX_CORES = 64 };
+// The largest number of accesses a core simulates between two bus phases
+enum { COHERENCE_QUANTUM = 1024 };
+
+// The coherence statistics of one core
+typedef struct {
+    // The read misses, which were broadcast as BusRd
+    uint64_t bus_reads;
+    // The write misses, which were broadcast as BusRdX
+    uint64_t bus_read_exclusives;
+    // The writes to Shared blocks, which were broadcast as BusUpgr
+    uint64_t bus_upgrades;
+    // The Modified blocks written back, when they were evicted or when
+    // another core asked for them
+    uint64_t bus_writebacks;
+    // The blocks of this core's caches invalidated by the writes of others
+    uint64_t invalidations;
+    // The misses on blocks that were invalidated by another core
+    uint64_t coherence_misses;
+} coherence_stat_t;
+
+// Simulates a multi-core system in which every core runs the accesses of its
+// own trace on private caches of `config`, kept coherent by the MESI protocol
+// on a snooping bus.
+//
+// The simulation proceeds in rounds. In the local phase of a round, the cores
+// run in parallel on up to `threads` host threads, each one until it reaches
+// an access that needs the bus or has simulated COHERENCE_QUANTUM accesses.
+// Reads of valid blocks and writes of Exclusive or Modified blocks stay local.
+// In the bus phase, the waiting accesses are then broadcast one core at a time
+// in core order. This is a valid interleaving of the traces that does not
+// depend on the number of threads, so the results are deterministic.
+//
+// `traces` are the open traces of the cores, and `stats` and `coherence` get
+// the statistics of each core. `status` is set to TRACE_END, or to the error
+// that stopped the first core whose trace was invalid. If some threads cannot
+// be started, the cores are simulated on the others. Returns 0 on success, or
+// -1 if the memory of the caches or of their block states could not be
+// allocated.
+int simulate_coherent(const cache_config_t *config, trace_reader_t *traces,
+                      size_t cores, unsigned threads, cache_stat_t *stats,
+                      coherence_stat_t *coherence, trace_status_t *status);
+
+// Returns a description of why caches of a valid configuration cannot be kept
+// coherent, or NULL if they can
+const char *coherence_config_error(const cache_config_t *config);
+
+// Returns the bus transactions of a core's statistics
+uint64_t coherence_bus_transactions(const coherence_stat_t *stat);
+
+#endif
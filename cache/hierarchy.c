@@ -0,0 +1,220 @@
+#include "hierarchy.h"
+
+#include <string.h>
+
+// The default latency of each level in cycles
+static const uint32_t default_latency[HIERARCHY_MAX_LEVELS] = {4, 12, 40, 80};
+
+// The command-line name of each inclusion policy
+static const char *const inclusion_names[] = {
+    [INCLUSION_NINE] = "nine",
+    [INCLUSION_INCLUSIVE] = "incl",
+    [INCLUSION_EXCLUSIVE] = "excl",
+};
+
+int parse_level_config(const char *const spec, const size_t level,
+                       level_config_t *const config) {
+    if (level >= HIERARCHY_MAX_LEVELS) {
+        return -1;
+    }
+
+    char cache_spec[128];
+    if (strlen(spec) >= sizeof(cache_spec)) {
+        return -1;
+    }
+    strcpy(cache_spec, spec);
+
+    // Split off the latency
+    config->latency = default_latency[level];
+    char *const at = strchr(cache_spec, '@');
+    if (at != NULL) {
+        *at = '\0';
+        if (parse_cache_size(at + 1, &config->latency) < 0) {
+            return -1;
+        }
+    }
+
+    // Split off the inclusion policy, which is never a replacement policy
+    config->inclusion = INCLUSION_NINE;
+    char *const colon = strrchr(cache_spec, ':');
+    if (colon != NULL) {
+        for (size_t i = 0;
+             i < sizeof(inclusion_names) / sizeof(inclusion_names[0]); i++) {
+            if (strcmp(colon + 1, inclusion_names[i]) == 0) {
+                config->inclusion = (inclusion_t)i;
+                *colon = '\0';
+                break;
+            }
+        }
+    }
+
+    return parse_cache_config(cache_spec, &config->cache);
+}
+
+const char *hierarchy_config_error(const level_config_t *const levels,
+                                   const size_t count) {
+    if (count == 0 || count > HIERARCHY_MAX_LEVELS) {
+        return "A hierarchy needs between 1 and 4 levels";
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const char *const error = cache_config_error(&levels[i].cache);
+        if (error != NULL) {
+            return error;
+        }
+        if (i > 0 && levels[i].cache.organization == SPLIT) {
+            return "Only the first level can be split";
+        }
+        // The levels only look up and fill blocks, so stores are reads and
+        // nothing observes the accesses of a level but the level itself
+        if (levels[i].cache.write_policy != WRITE_BACK ||
+            levels[i].cache.write_miss != WRITE_ALLOCATE) {
+            return "The levels of a hierarchy are write-back and "
+                   "write-allocate";
+        }
+        if (levels[i].cache.prefetcher != NULL) {
+            return "The levels of a hierarchy cannot prefetch";
+        }
+        if (levels[i].cache.classify_misses) {
+            return "The misses of a hierarchy cannot be classified";
+        }
+        // Blocks move between the levels whole
+        if (i > 0 &&
+            (levels[i].cache.block_size != levels[0].cache.block_size ||
+             levels[i].cache.address_bits != levels[0].cache.address_bits)) {
+            return "Every level needs the same block size and address width";
+        }
+    }
+
+    return NULL;
+}
+
+int hierarchy_init(hierarchy_t *const hierarchy,
+                   const level_config_t *const levels, const size_t count,
+                   const uint32_t memory_latency) {
+    memset(hierarchy, 0, sizeof(hierarchy_t));
+
+    for (size_t i = 0; i < count; i++) {
+        if (create_context(&levels[i].cache, &hierarchy->levels[i]) < 0) {
+            // Free the levels that were created
+            hierarchy->level_count = i;
+            hierarchy_free(hierarchy);
+            return -1;
+        }
+        // The first level has nothing above it
+        hierarchy->inclusion[i] = i == 0 ? INCLUSION_NINE : levels[i].inclusion;
+        hierarchy->latency[i] = levels[i].latency;
+    }
+    hierarchy->level_count = count;
+    hierarchy->memory_latency = memory_latency;
+    return 0;
+}
+
+void hierarchy_free(hierarchy_t *const hierarchy) {
+    for (size_t i = 0; i < hierarchy->level_count; i++) {
+        destroy_context(hierarchy->levels[i]);
+    }
+    hierarchy->level_count = 0;
+}
+
+// Looks up an access in level `level` and counts it in the level's statistics.
+// Returns 1 on a hit, otherwise 0.
+static int read_level(hierarchy_t *const hierarchy, const size_t level,
+                      const mem_access_t access) {
+    cache_stat_t *const stat = &hierarchy->stats[level];
+    const int hit = cache_probe(hierarchy->levels[level], access);
+
+    stat->accesses++;
+    stat->hits += (uint64_t)hit;
+    if (access.accessType == INSTRUCTION) {
+        stat->instr_accesses++;
+        stat->instr_hits += (uint64_t)hit;
+    } else {
+        stat->data_accesses++;
+        stat->data_hits += (uint64_t)hit;
+    }
+
+    return hit;
+}
+
+static void fill_level(hierarchy_t *hierarchy, size_t level,
+                       mem_access_t access);
+
+// Handles the block `victim` that level `level` evicted
+static void evict_block(hierarchy_t *const hierarchy, const size_t level,
+                        const mem_access_t victim) {
+    // An inclusive level may not lose a block that the levels above still hold
+    if (hierarchy->inclusion[level] == INCLUSION_INCLUSIVE) {
+        for (size_t above = 0; above < level; above++) {
+            if (cache_invalidate(hierarchy->levels[above], victim.address)) {
+                hierarchy->back_invalidations++;
+            }
+        }
+    }
+
+    // An exclusive level below is filled with the victims of this one. With a
+    // split first level the block may already be there from the other cache.
+    const size_t below = level + 1;
+    if (below < hierarchy->level_count &&
+        hierarchy->inclusion[below] == INCLUSION_EXCLUSIVE &&
+        !cache_probe(hierarchy->levels[below], victim)) {
+        fill_level(hierarchy, below, victim);
+    }
+}
+
+// Inserts the block of `access` into level `level`, which does not hold it
+static void fill_level(hierarchy_t *const hierarchy, const size_t level,
+                       const mem_access_t access) {
+    uint64_t victim;
+    if (cache_fill(hierarchy->levels[level], access, &victim)) {
+        evict_block(hierarchy, level,
+                    (mem_access_t){.address = victim,
+                                   .accessType = access.accessType});
+    }
+}
+
+void hierarchy_access(hierarchy_t *const hierarchy,
+                      const mem_access_t access) {
+    // Only the misses of a level reach the next one
+    size_t hit_level = 0;
+    while (hit_level < hierarchy->level_count &&
+           !read_level(hierarchy, hit_level, access)) {
+        hit_level++;
+    }
+
+    if (hit_level == hierarchy->level_count) {
+        hierarchy->memory_accesses++;
+    } else if (hierarchy->inclusion[hit_level] == INCLUSION_EXCLUSIVE) {
+        // The block moves up, which frees its line for the victim of the level
+        // above
+        cache_invalidate(hierarchy->levels[hit_level], access.address);
+    }
+
+    // Fill the levels that missed from the bottom up, except for exclusive
+    // levels which are only filled with victims
+    for (size_t level = hit_level; level-- > 0;) {
+        if (hierarchy->inclusion[level] != INCLUSION_EXCLUSIVE) {
+            fill_level(hierarchy, level, access);
+        }
+    }
+}
+
+double hierarchy_amat(const hierarchy_t *const hierarchy) {
+    if (hierarchy->level_count == 0 || hierarchy->stats[0].accesses == 0) {
+        return 0.0;
+    }
+
+    // Every access pays the latency of each level it reaches
+    double cycles = (double)hierarchy->memory_accesses *
+                    (double)hierarchy->memory_latency;
+    for (size_t i = 0; i < hierarchy->level_count; i++) {
+        cycles += (double)hierarchy->stats[i].accesses *
+                  (double)hierarchy->latency[i];
+    }
+
+    return cycles / (double)hierarchy->stats[0].accesses;
+}
+
+const char *inclusion_name(const inclusion_t inclusion) {
+    return inclusion_names[inclusion];
+}
@@ -0,0 +1,87 @@
+#ifndef HIERARCHY_H
+#define HIERARCHY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "trace.h"
+
+// The largest number of levels in a cache hierarchy
+enum { HIERARCHY_MAX_LEVELS = 4 };
+
+// How the contents of a level relate to the levels above it
+typedef enum {
+    // Non-inclusive non-exclusive: blocks are filled into every level that
+    // missed and evicted independently
+    INCLUSION_NINE,
+    // The level holds every block of the levels above it, so evicting a block
+    // also invalidates it above
+    INCLUSION_INCLUSIVE,
+    // The level only holds blocks evicted from the level directly above it, and
+    // a hit moves the block up
+    INCLUSION_EXCLUSIVE,
+} inclusion_t;
+
+// The configuration of one level of a hierarchy
+typedef struct {
+    // The caches of the level
+    cache_config_t cache;
+    // How the level relates to the levels above it. Ignored for the first
+    // level.
+    inclusion_t inclusion;
+    // The cycles needed to access the level
+    uint32_t latency;
+} level_config_t;
+
+// A hierarchy of caches where only the misses of a level reach the next one.
+// Only the first level may be split; the levels below it are unified.
+typedef struct {
+    // The caches of each level, with the first level closest to the processor
+    cache_context_t levels[HIERARCHY_MAX_LEVELS];
+    // How each level relates to the levels above it
+    inclusion_t inclusion[HIERARCHY_MAX_LEVELS];
+    // The cycles needed to access each level
+    uint32_t latency[HIERARCHY_MAX_LEVELS];
+    // The number of levels
+    size_t level_count;
+    // The cycles needed to access main memory
+    uint32_t memory_latency;
+
+    // The statistics of each level, counting only the accesses that reached it
+    cache_stat_t stats[HIERARCHY_MAX_LEVELS];
+    // The accesses that missed in every level
+    uint64_t memory_accesses;
+    // The blocks invalidated above an inclusive level when it evicted them
+    uint64_t back_invalidations;
+} hierarchy_t;
+
+// Parses the configuration of level `level` (from 0) written as
+// "<size>:<mapping>:<organization>[:<policy>][:<inclusion>][@<latency>]", e.g.
+// "262144:sa8:uc:lru:incl@12". The inclusion is "nine" (the default), "incl" or
+// "excl", and the latency defaults to a typical value for the level. Returns 0
+// on success, or -1 if it is invalid.
+int parse_level_config(const char *spec, size_t level, level_config_t *config);
+
+// Returns a description of why a hierarchy cannot be simulated, or NULL if it
+// can
+const char *hierarchy_config_error(const level_config_t *levels, size_t count);
+
+// Creates the caches of a valid hierarchy with zeroed statistics. Returns 0 on
+// success, or -1 if they cannot be allocated.
+int hierarchy_init(hierarchy_t *hierarchy, const level_config_t *levels,
+                   size_t count, uint32_t memory_latency);
+
+// Frees the caches of a hierarchy
+void hierarchy_free(hierarchy_t *hierarchy);
+
+// Simulates an access through the levels of a hierarchy
+void hierarchy_access(hierarchy_t *hierarchy, mem_access_t access);
+
+// Returns the average memory access time in cycles of the accesses so far
+double hierarchy_amat(const hierarchy_t *hierarchy);
+
+// Returns the command-line name of an inclusion policy
+const char *inclusion_name(inclusion_t inclusion);
+
+#endif
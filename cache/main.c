@@ -1,275 +1,1246 @@
 #include <inttypes.h>
-#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-enum { ADDRESS_BITS = 32 };
-enum { BLOCK_SIZE = 64 };
+#include "analysis.h"
+#include "cache.h"
+#include "cachesim.h"
+#include "coherence.h"
+#include "hierarchy.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "prefilter.h"
+#include "stackdist.h"
+#include "telemetry.h"
+#include "trace.h"
 
-typedef enum { DIRECT_MAPPING, FULLY_ASSOCIATIVE } cache_map_t;
-typedef enum { UNIFIED, SPLIT } cache_org_t;
-typedef enum { INSTRUCTION, DATA } access_t;
+// The smallest and largest cache sizes in the default sweep
+enum { SWEEP_MIN_SIZE = 128, SWEEP_MAX_SIZE = 4096 };
 
-typedef struct {
-    uint32_t address;
-    access_t accessType;
-} mem_access_t;
+// The largest cache size in the default stack distance curve
+enum { CURVE_MAX_SIZE = 1 << 20 };
 
-typedef struct {
-    uint64_t accesses;
-    uint64_t hits;
-    // You can declare additional statistics if
-    // you like, however you are now allowed to
-    // remove the accesses or hits
-    uint64_t instr_accesses;
-    uint64_t instr_hits;
-    uint64_t data_accesses;
-    uint64_t data_hits;
-} cache_stat_t;
-
-// A cache line
-typedef struct {
-    // Whether the cache line contains valid data or not
-    uint8_t valid;
-    // The tag of the cache line
-    uint32_t tag;
-} cache_line_t;
+// The default number of accesses in each working set window of an analysis
+enum { DEFAULT_ANALYSIS_WINDOW = 100000 };
 
-// The cache data structure
-typedef struct {
-    // An array of cache lines
-    cache_line_t *lines;
-    // The size of the cache lines array
-    uintptr_t size;
-    // The tail index for the FIFO queue when the cache is Fully Associative
-    uintptr_t tail_index;
-} cache_t;
-
-// Context information for the cache(s)
+// The default number of accesses between checkpoints
+enum { DEFAULT_CHECKPOINT_INTERVAL = 100000000 };
+
+// The default main memory latency of a hierarchy in cycles
+enum { DEFAULT_MEMORY_LATENCY = 200 };
+
+// Command-line options shared by every mode
 typedef struct {
-    // The instruction cache
-    cache_t *instr_cache;
-    // The data cache
-    cache_t *data_cache;
-    // The cache mapping
-    cache_map_t mapping;
-    // The cache organization
-    cache_org_t organization;
-
-    // Number of bits to use for the offset
-    uint32_t offset_bits;
-    // Number of bits to use for the index
-    uint32_t index_bits;
-    // Number of bits to use for the tag
-    uint32_t tag_bits;
-} cache_context_t;
-
-cache_context_t create_context(uint32_t cache_size,
-                               const cache_map_t cache_mapping,
-                               const cache_org_t cache_org) {
-    if (cache_org == SPLIT) {
-        cache_size /= 2;
-    }
-
-    const uint32_t line_count = cache_size / BLOCK_SIZE;
-    const uint32_t offset_bits = (uint32_t)log2(BLOCK_SIZE);
-    const uint32_t index_bits =
-        cache_mapping == DIRECT_MAPPING ? (uint32_t)log2(line_count) : 0;
-    const uint32_t tag_bits = ADDRESS_BITS - index_bits - offset_bits;
-
-    cache_t *const instr_cache = malloc(sizeof(cache_t));
-    // Allocate zero-initialized memory for the cache lines
-    instr_cache->lines = calloc(line_count, sizeof(cache_line_t));
-    instr_cache->size = line_count;
-    instr_cache->tail_index = 0;
-
-    cache_t *data_cache;
-    if (cache_org == UNIFIED) {
-        data_cache = instr_cache;
-    } else {
-        data_cache = malloc(sizeof(cache_t));
-        // Allocate zero-initialized memory for the cache lines
-        data_cache->lines = calloc(line_count, sizeof(cache_line_t));
-        data_cache->size = line_count;
-        data_cache->tail_index = 0;
-    }
-
-    const cache_context_t cache_ctx = {.instr_cache = instr_cache,
-                                       .data_cache = data_cache,
-                                       .mapping = cache_mapping,
-                                       .organization = cache_org,
-                                       .offset_bits = offset_bits,
-                                       .index_bits = index_bits,
-                                       .tag_bits = tag_bits};
-
-    return cache_ctx;
+    // The text or binary trace to simulate, or "-" for standard input
+    const char *trace_path;
+    // The number of threads for sweeps, shards and coherent simulations
+    unsigned threads;
+    // Whether the trace is decoded on a separate thread
+    int pipelined;
+    // Whether every access is printed as it is simulated
+    int verbose;
+    // The main memory latency of a hierarchy in cycles
+    uint32_t memory_latency;
+    // Whether every miss is classified as compulsory, capacity or conflict
+    int classify;
+    // Whether a single Direct Mapped or Set Associative cache is split by set
+    // across the threads
+    int sharded;
+    // The number of accesses between telemetry snapshots, or 0 for none
+    uint32_t telemetry_interval;
+    // The file descriptor the telemetry snapshots are written to
+    int telemetry_fd;
+    // How the telemetry snapshots are written
+    telemetry_format_t telemetry_format;
+    // The file checkpoints are written to, or NULL for none
+    const char *checkpoint_path;
+    // The number of accesses between checkpoints, or 0 if -K was not given
+    // and DEFAULT_CHECKPOINT_INTERVAL is used
+    uint32_t checkpoint_interval;
+    // The checkpoint to resume from, or NULL to start at the beginning
+    const char *resume_path;
+    // When stores reach the next level
+    write_policy_t write_policy;
+    // What a store that misses does
+    write_miss_t write_miss;
+    // The prefetcher of each cache, or NULL for none
+    const prefetcher_t *prefetcher;
+    // How far ahead the prefetcher fetches
+    uint32_t prefetch_degree;
+    // The number of accesses a prefetch takes to arrive
+    uint32_t prefetch_latency;
+    // The size of a block in bytes
+    uint32_t block_size;
+    // The number of address bits. Wider addresses in the trace are an error.
+    uint32_t address_bits;
+    // Whether repeated accesses to a block are collapsed before the cache
+    int prefiltered;
+} options_t;
+
+// Prints the command-line usage and exits
+static void usage(void) {
+    printf("usage: cache_sim [options] <cache size: 128-4096> "
+           "<cache mapping: dm|fa|sa<ways>> <cache organization: uc|sc> "
+           "[<replacement policy: fifo|lru|plru|srrip>]\n"
+           "       cache_sim [options] --sweep "
+           "[<size>:<mapping>:<organization>[:<policy>]...]\n"
+           "       cache_sim [options] --stack-distance [<max cache size>]\n"
+           "       cache_sim [options] --analyze [<window>]\n"
+           "       cache_sim [options] --hierarchy "
+           "<size>:<mapping>:<organization>[:<policy>][:nine|incl|excl]"
+           "[@<latency>]...\n"
+           "       cache_sim [options] --coherent "
+           "<size>:<mapping>:<organization>[:<policy>] <trace>...\n"
+           "\n"
+           "options:\n"
+           "  -t <trace file>  the text or binary trace, - for standard input "
+           "(mem_trace.txt)\n"
+           "  -j <threads>     threads for sweeps, shards and cores "
+           "(all processors)\n"
+           "  -p               decode the trace on a separate thread\n"
+           "  -v               print every access as it is simulated\n"
+           "  -m <cycles>      main memory latency of a hierarchy (200)\n"
+           "  -c               classify misses as compulsory, capacity or "
+           "conflict\n"
+           "  -s               split a dm or sa cache by set across the "
+           "threads\n"
+           "  -w wb|wt         write-back or write-through (wb)\n"
+           "  -a wa|nwa        write-allocate or no-write-allocate (wa)\n"
+           "  -P <prefetcher>  prefetch with next|stride|stream[:<degree>]\n"
+           "  -L <accesses>    accesses a prefetch takes to arrive (16)\n"
+           "  -b <bytes>       block size, a power of two (64)\n"
+           "  -A <bits>        address width, up to 64 (32)\n"
+           "  -e               count repeated hits to a block without "
+           "simulating them,\n"
+           "                   for a single cache or a sweep\n"
+           "  -i <accesses>    write statistics snapshots every <accesses> "
+           "accesses\n"
+           "  -d <fd>          file descriptor for the snapshots (2)\n"
+           "  -f csv|json      format of the snapshots (csv)\n"
+           "  -k <file>        write a checkpoint to <file> periodically\n"
+           "  -K <accesses>    accesses between checkpoints (100000000)\n"
+           "  -r <file>        resume from the checkpoint in <file>\n"
+           "\n"
+           "--analyze remembers every distinct block of the trace for exact "
+           "reuse\n"
+           "distances, so its memory grows with the footprint of the trace.\n");
+    exit(1);
 }
 
-// Reads a memory access from the trace file and returns
-//  * access type (instruction or data access)
-//  * memory address
-mem_access_t read_transaction(FILE *ptr_file) {
-    char type;
-    mem_access_t access;
-
-    if (fscanf(ptr_file, "%c %x\n", &type, &access.address) == 2) {
-        if (type == 'I') {
-            access.accessType = INSTRUCTION;
-        } else if (type == 'D') {
-            access.accessType = DATA;
-        } else {
-            printf("Unkown access type\n");
-            exit(0);
+// Opens the trace file at `path`, or standard input if it is "-", and exits if
+// it cannot be opened
+static void open_trace_path(trace_reader_t *const trace,
+                            const char *const path,
+                            const options_t *const options) {
+    const int result = strcmp(path, "-") == 0
+                           ? trace_open_fd(trace, STDIN_FILENO)
+                           : trace_open(trace, path);
+    if (result < 0) {
+        printf("Unable to open the trace file\n");
+        exit(1);
+    }
+    trace_set_address_bits(trace, options->address_bits);
+}
+
+// Opens the trace file of the options
+static void open_trace(trace_reader_t *const trace,
+                       const options_t *const options) {
+    open_trace_path(trace, options->trace_path, options);
+}
+
+// Opens the trace file and starts decoding it, on a separate thread if the
+// options ask for it
+static void open_input(trace_reader_t *const trace,
+                       pipeline_t *const pipeline,
+                       const options_t *const options) {
+    open_trace(trace, options);
+    pipeline_open(pipeline, trace, options->pipelined);
+}
+
+// Stops decoding and closes the trace file
+static void close_input(trace_reader_t *const trace,
+                        pipeline_t *const pipeline) {
+    pipeline_close(pipeline);
+    trace_close(trace);
+}
+
+// Exits with an error message if reading the trace stopped because of an
+// invalid trace rather than its end
+static void check_trace_status(const trace_status_t status) {
+    if (status == TRACE_BAD_TYPE) {
+        printf("Unkown access type\n");
+        exit(0);
+    } else if (status == TRACE_BAD_ADDRESS) {
+        printf("Invalid address in the trace file\n");
+        exit(1);
+    } else if (status == TRACE_WIDE_ADDRESS) {
+        printf("An address in the trace file is wider than the address "
+               "width (-A)\n");
+        exit(1);
+    } else if (status == TRACE_BAD_FORMAT) {
+        printf("Corrupt binary trace file\n");
+        exit(1);
+    } else if (status == TRACE_READ_ERROR) {
+        printf("Unable to read the trace file\n");
+        exit(1);
+    }
+}
+
+// Exits with an error message if the options ask for what only a single cache
+// simulation does: checkpoints, printed accesses, telemetry or splitting the
+// cache by set
+static void reject_single_cache_options(const options_t *const options) {
+    if (options->checkpoint_path != NULL || options->resume_path != NULL ||
+        options->checkpoint_interval != 0) {
+        printf("Only a single cache simulation can be checkpointed\n");
+        exit(1);
+    }
+    if (options->verbose) {
+        printf("Only a single cache simulation can print its accesses\n");
+        exit(1);
+    }
+    if (options->telemetry_interval != 0) {
+        printf("Only a single cache simulation has telemetry\n");
+        exit(1);
+    }
+    if (options->sharded) {
+        printf("Only a single cache simulation can be split by set\n");
+        exit(1);
+    }
+}
+
+// Feeds a batch to a simulation. The trace was read with the address width of
+// the simulation, so its addresses always fit and only the miss classification
+// can fail.
+static void feed_simulation(cachesim_t *const sim,
+                            const mem_access_t *const batch,
+                            const size_t count) {
+    if (cachesim_feed(sim, batch, count) < 0) {
+        printf("Unable to allocate the memory to classify the misses\n");
+        exit(1);
+    }
+}
+
+// Feeds a batch to a simulation. When `telemetry` is not NULL the batch is
+// split where telemetry windows end, and a snapshot is written after each of
+// them.
+static void simulate_batch(cachesim_t *const sim,
+                           const mem_access_t *const batch, const size_t count,
+                           telemetry_t *const telemetry) {
+    if (telemetry == NULL) {
+        feed_simulation(sim, batch, count);
+        return;
+    }
+
+    cache_stat_t stat;
+    size_t done = 0;
+    while (done < count) {
+        cachesim_stats(sim, &stat);
+        const uint64_t remaining = telemetry_remaining(telemetry, &stat);
+        const size_t n =
+            count - done < remaining ? count - done : (size_t)remaining;
+        feed_simulation(sim, batch + done, n);
+        cachesim_stats(sim, &stat);
+        telemetry_update(telemetry, &stat);
+        done += n;
+    }
+}
+
+// Returns hits / accesses, or 0 if there were no accesses
+static double hit_rate(const uint64_t hits, const uint64_t accesses) {
+    return accesses == 0 ? 0.0 : (double)hits / (double)accesses;
+}
+
+// Creates a simulation of a valid configuration, with the pre-filter in front
+// of it if `prefiltered` is set, and exits if it cannot be created
+static cachesim_t *create_simulation(const cache_config_t *const config,
+                                     const int prefiltered) {
+    const char *error;
+    cachesim_t *const sim = cachesim_create(config, &error);
+    if (sim == NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+    if (prefiltered && cachesim_enable_prefilter(sim, &error) < 0) {
+        printf("%s\n", error);
+        exit(1);
+    }
+    return sim;
+}
+
+// Simulates every configuration in `configs` with a single pass over the trace
+static void sweep_serial(const options_t *const options,
+                         const cache_config_t *const configs,
+                         const size_t config_count, cache_stat_t *const stats) {
+    cachesim_t **const sims = malloc(config_count * sizeof(cachesim_t *));
+    for (size_t c = 0; c < config_count; c++) {
+        sims[c] = create_simulation(&configs[c], options->prefiltered);
+    }
+
+    trace_reader_t trace;
+    pipeline_t pipeline;
+    open_input(&trace, &pipeline, options);
+
+    trace_status_t status;
+
+    // Decode each batch once and feed it to every cache, one cache at a time
+    // so its lines stay in the host cache for the whole batch
+    do {
+        size_t count;
+        const mem_access_t *const batch =
+            pipeline_next(&pipeline, &count, &status);
+
+        for (size_t c = 0; c < config_count; c++) {
+            feed_simulation(sims[c], batch, count);
         }
+    } while (status == TRACE_OK);
+
+    check_trace_status(status);
+    close_input(&trace, &pipeline);
 
-        return access;
+    for (size_t c = 0; c < config_count; c++) {
+        cachesim_stats(sims[c], &stats[c]);
+        cachesim_destroy(sims[c]);
     }
+    free(sims);
+}
+
+// The state shared by the workers of a parallel sweep
+typedef struct {
+    // The whole decoded trace, which is only read by the workers
+    const mem_access_t *accesses;
+    // The number of accesses in the trace
+    size_t access_count;
+    // The configurations to simulate
+    const cache_config_t *configs;
+    // The statistics of each configuration
+    cache_stat_t *stats;
+    // Whether repeated accesses to a block are collapsed before each cache
+    int prefiltered;
+} sweep_job_t;
 
-    // If there are no more entries in the file, return an address 0 that will
-    // terminate the infinite loop in main
-    access.address = 0;
-    return access;
+// Simulates configuration `task` of a parallel sweep over the whole trace
+static void sweep_task(const size_t task, void *const arg) {
+    const sweep_job_t *const job = arg;
+    cachesim_t *const sim =
+        create_simulation(&job->configs[task], job->prefiltered);
+
+    // The statistics are only written once at the end, so workers never
+    // share host cache lines in the loop
+    feed_simulation(sim, job->accesses, job->access_count);
+    cachesim_stats(sim, &job->stats[task]);
+
+    cachesim_destroy(sim);
 }
 
-// Extracts the bits starting at `startBit` with length `len` and returns them
-// as an integer
-uint32_t extract_bits(const uint32_t val, const uint32_t startBit,
-                      const uint32_t len) {
-    uint32_t mask = ((1U << len) - 1U) << startBit;
-    return (val & mask) >> startBit;
+// Decodes the whole trace once and simulates the configurations in `configs`
+// on `options->threads` worker threads that share the decoded trace
+static void sweep_parallel(const options_t *const options,
+                           const cache_config_t *const configs,
+                           const size_t config_count,
+                           cache_stat_t *const stats) {
+    trace_reader_t trace;
+    open_trace(&trace, options);
+
+    size_t access_count;
+    trace_status_t status;
+    mem_access_t *const accesses =
+        trace_read_all(&trace, &access_count, &status);
+    if (accesses == NULL) {
+        printf("Unable to allocate the trace\n");
+        exit(1);
+    }
+    check_trace_status(status);
+    trace_close(&trace);
+
+    sweep_job_t job = {.accesses = accesses,
+                       .access_count = access_count,
+                       .configs = configs,
+                       .stats = stats,
+                       .prefiltered = options->prefiltered};
+    if (pool_run(options->threads, config_count, sweep_task, &job) < 0) {
+        printf("Unable to allocate the memory or start the worker threads\n");
+        exit(1);
+    }
+
+    free(accesses);
 }
 
-// Perform a cache read using the given context, memory access, and statistics
-void cache_read(const cache_context_t ctx, const mem_access_t access,
-                cache_stat_t *const stat) {
-    stat->accesses++;
-
-    uint32_t index =
-        extract_bits(access.address, ctx.offset_bits, ctx.index_bits);
-    uint32_t tag = extract_bits(access.address,
-                                ctx.offset_bits + ctx.index_bits, ctx.tag_bits);
-
-    cache_t *cache;
-    // The cache hits for this specific cache (in case of split organization)
-    uint64_t *cache_hits;
-    if (access.accessType == INSTRUCTION) {
-        cache = ctx.instr_cache;
-        cache_hits = &stat->instr_hits;
-        stat->instr_accesses++;
+// Simulates every configuration in `configs` and prints a table with the
+// statistics of each one. With more than one thread the configurations are
+// simulated in parallel, which needs the whole decoded trace in memory.
+static void run_sweep(const options_t *const options,
+                      const cache_config_t *const configs,
+                      const size_t config_count) {
+    cache_stat_t *const stats = calloc(config_count, sizeof(cache_stat_t));
+
+    if (options->threads > 1 && config_count > 1) {
+        sweep_parallel(options, configs, config_count, stats);
     } else {
-        cache = ctx.data_cache;
-        cache_hits = &stat->data_hits;
-        stat->data_accesses++;
+        sweep_serial(options, configs, config_count, stats);
     }
 
-    if (ctx.mapping == DIRECT_MAPPING) {
-        // Make sure the index is in bounds
-        if (index >= cache->size) {
-            printf("Invalid cache index\n");
-            exit(1);
+    printf("%8s %7s %12s %6s %12s %12s %8s %8s %8s", "Size", "Mapping",
+           "Organization", "Policy", "Accesses", "Hits", "Hit Rate", "I Rate",
+           "D Rate");
+    if (options->classify) {
+        printf(" %12s %12s %12s", "Compulsory", "Capacity", "Conflict");
+    }
+    // Every configuration sees the same trace, so they all have stores or
+    // none do. Prefetches add traffic of their own.
+    const int traffic = (config_count > 0 && stats[0].writes > 0) ||
+                        options->prefetcher != NULL;
+    if (traffic) {
+        printf(" %12s %14s %14s", "Writebacks", "Bytes Read", "Bytes Written");
+    }
+    if (options->prefetcher != NULL) {
+        printf(" %12s %12s %12s %12s", "Prefetches", "Useful", "Late",
+               "Polluting");
+    }
+    printf("\n");
+    for (size_t c = 0; c < config_count; c++) {
+        const cache_stat_t *const stat = &stats[c];
+        char mapping[16];
+        format_cache_mapping(&configs[c], mapping, sizeof(mapping));
+        printf("%8" PRIu32 " %7s %12s %6s %12" PRIu64 " %12" PRIu64
+               " %8.4f %8.4f %8.4f",
+               configs[c].size, mapping,
+               cache_org_name(configs[c].organization),
+               cache_policy_name(&configs[c]), stat->accesses,
+               stat->hits, hit_rate(stat->hits, stat->accesses),
+               hit_rate(stat->instr_hits, stat->instr_accesses),
+               hit_rate(stat->data_hits, stat->data_accesses));
+        if (options->classify) {
+            printf(" %12" PRIu64 " %12" PRIu64 " %12" PRIu64,
+                   stat->compulsory_misses, stat->capacity_misses,
+                   stat->conflict_misses);
+        }
+        if (traffic) {
+            printf(" %12" PRIu64 " %14" PRIu64 " %14" PRIu64, stat->writebacks,
+                   stat->bytes_read, stat->bytes_written);
+        }
+        if (options->prefetcher != NULL) {
+            printf(" %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64,
+                   stat->prefetches_issued, stat->prefetches_useful,
+                   stat->prefetches_late, stat->prefetches_polluting);
         }
+        printf("\n");
+    }
 
-        // Get the cache line associated with this index
-        cache_line_t *line = &cache->lines[index];
-        if (line->valid && line->tag == tag) {
-            stat->hits++;
-            (*cache_hits)++;
-        } else {
-            // Replace the cached value
-            line->valid = 1;
-            line->tag = tag;
+    free(stats);
+}
+
+// Parses the configurations of a sweep and runs it. Without any
+// configurations, every size from SWEEP_MIN_SIZE to SWEEP_MAX_SIZE is swept
+// with every mapping and organization.
+static void sweep(const options_t *const options, const int argc,
+                  const char **const argv) {
+    reject_single_cache_options(options);
+
+    size_t config_count = 0;
+    cache_config_t *configs;
+
+    if (argc > 0) {
+        configs = malloc((size_t)argc * sizeof(cache_config_t));
+        for (int i = 0; i < argc; i++) {
+            if (parse_cache_config(argv[i], &configs[config_count]) < 0) {
+                printf("Invalid cache configuration: %s\n", argv[i]);
+                exit(1);
+            }
+            configs[config_count].classify_misses = options->classify;
+            configs[config_count].write_policy = options->write_policy;
+            configs[config_count].write_miss = options->write_miss;
+            configs[config_count].prefetcher = options->prefetcher;
+            configs[config_count].prefetch_degree = options->prefetch_degree;
+            configs[config_count].prefetch_latency =
+                options->prefetch_latency;
+            configs[config_count].block_size = options->block_size;
+            configs[config_count].address_bits = options->address_bits;
+            const char *const error =
+                cache_config_error(&configs[config_count]);
+            if (error != NULL) {
+                printf("%s: %s\n", argv[i], error);
+                exit(1);
+            }
+            config_count++;
         }
     } else {
-        // Mapping is Fully associative
-
-        // Loop through the cache lines and look for a matching tag
-        for (uintptr_t i = 0; i < cache->size; i++) {
-            cache_line_t *line = &cache->lines[i];
-            if (line->valid && line->tag == tag) {
-                stat->hits++;
-                (*cache_hits)++;
-                return;
+        const cache_map_t mappings[] = {DIRECT_MAPPING, FULLY_ASSOCIATIVE};
+        const cache_org_t orgs[] = {UNIFIED, SPLIT};
+        size_t max_configs = 0;
+        for (uint32_t size = SWEEP_MIN_SIZE; size <= SWEEP_MAX_SIZE;
+             size *= 2) {
+            max_configs += 4;
+        }
+        configs = malloc(max_configs * sizeof(cache_config_t));
+        for (uint32_t size = SWEEP_MIN_SIZE; size <= SWEEP_MAX_SIZE;
+             size *= 2) {
+            for (int m = 0; m < 2; m++) {
+                for (int o = 0; o < 2; o++) {
+                    configs[config_count++] = (cache_config_t){
+                        .size = size,
+                        .mapping = mappings[m],
+                        .organization = orgs[o],
+                        .ways = 0,
+                        .block_size = options->block_size,
+                        .address_bits = options->address_bits,
+                        .policy = NULL,
+                        .classify_misses = options->classify,
+                        .write_policy = options->write_policy,
+                        .write_miss = options->write_miss,
+                        .prefetcher = options->prefetcher,
+                        .prefetch_degree = options->prefetch_degree,
+                        .prefetch_latency = options->prefetch_latency};
+                }
             }
         }
+    }
 
-        // A matching tag was not found, so we insert it in the queue
-        cache_line_t *line = &cache->lines[cache->tail_index];
-        line->valid = 1;
-        line->tag = tag;
-        // Increment the tail index of the queue with wrap-around
-        cache->tail_index = (cache->tail_index + 1) % cache->size;
+    // Every configuration has the same prefetcher, so checking one of them
+    // catches the error before the trace is read
+    if (options->prefiltered && config_count > 0) {
+        const char *const error = prefilter_config_error(&configs[0]);
+        if (error != NULL) {
+            printf("%s\n", error);
+            exit(1);
+        }
     }
+
+    run_sweep(options, configs, config_count);
+    free(configs);
 }
 
-int main(const int argc, const char **argv) {
-    uint32_t cache_size;
-    cache_map_t cache_mapping;
-    cache_org_t cache_org;
+// Prints the hit rates of fully associative LRU caches of every power of two
+// size from two blocks to `max_size`, for both organizations, from a single
+// pass over the trace
+static void stack_distance_curve(const options_t *const options,
+                                 const uint32_t max_size) {
+    reject_single_cache_options(options);
 
-    // Read command-line parameters and initialize:
-    // cache_size, cache_mapping and cache_org variables
+    if (options->prefiltered) {
+        printf("The curve needs the distance of every access, so it cannot be "
+               "pre-filtered\n");
+        exit(1);
+    }
 
-    // argc should be 2 for correct execution
-    if (argc != 4) {
-        printf("usage: cache_sim <cache size: 128-4096> <cache mapping: dm|fa> "
-               "<cache organization: uc|sc>\n");
+    const uint32_t block_size = options->block_size;
+    const uint32_t block_bits = (uint32_t)__builtin_ctz(block_size);
+    // The split caches are half the size of the unified one
+    stack_distance_t unified;
+    stack_distance_t split[2];
+    stack_distance_init(&unified, max_size / block_size);
+    stack_distance_init(&split[INSTRUCTION], max_size / 2 / block_size);
+    stack_distance_init(&split[DATA], max_size / 2 / block_size);
+
+    trace_reader_t trace;
+    pipeline_t pipeline;
+    open_input(&trace, &pipeline, options);
+
+    trace_status_t status;
+    uint64_t accesses[2] = {0, 0};
+
+    do {
+        size_t count;
+        const mem_access_t *const batch =
+            pipeline_next(&pipeline, &count, &status);
+
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t block = batch[i].address >> block_bits;
+            stack_distance_access(&unified, block);
+            stack_distance_access(&split[batch[i].accessType], block);
+            accesses[batch[i].accessType]++;
+        }
+    } while (status == TRACE_OK);
+
+    check_trace_status(status);
+
+    const uint64_t total = accesses[INSTRUCTION] + accesses[DATA];
+    printf("%8s %12s %12s %12s %12s\n", "Size", "UC Hit Rate", "SC Hit Rate",
+           "SC I Rate", "SC D Rate");
+    for (uint32_t size = 2 * block_size; size <= max_size; size *= 2) {
+        const uint64_t instr_hits =
+            stack_distance_hits(&split[INSTRUCTION], size / 2 / block_size);
+        const uint64_t data_hits =
+            stack_distance_hits(&split[DATA], size / 2 / block_size);
+        printf("%8" PRIu32 " %12.4f %12.4f %12.4f %12.4f\n", size,
+               hit_rate(stack_distance_hits(&unified, size / block_size),
+                        total),
+               hit_rate(instr_hits + data_hits, total),
+               hit_rate(instr_hits, accesses[INSTRUCTION]),
+               hit_rate(data_hits, accesses[DATA]));
+    }
+
+    close_input(&trace, &pipeline);
+
+    stack_distance_free(&unified);
+    stack_distance_free(&split[INSTRUCTION]);
+    stack_distance_free(&split[DATA]);
+}
+
+// Prints one CSV row with the working set of `block_size` byte blocks of the
+// window that starts at access `first` and clears the working sets
+static void print_window(const uint64_t window, const uint64_t first,
+                         const uint64_t accesses, const uint32_t block_size,
+                         working_set_t *const all,
+                         working_set_t *const split) {
+    printf("%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%zu,%zu,%zu,%" PRIu64 "\n",
+           window, first, accesses, all->count, split[INSTRUCTION].count,
+           split[DATA].count, (uint64_t)all->count * block_size);
+    working_set_clear(all);
+    working_set_clear(&split[INSTRUCTION]);
+    working_set_clear(&split[DATA]);
+}
+
+// Characterises the trace in a single pass and prints two CSV tables
+// separated by an empty line: the working set of every window of `window`
+// accesses, as the windows complete, and then the log2 histogram of the reuse
+// distances of all accesses and of the instruction and data streams. The
+// working sets are bounded by the window, but the reuse distances grow with
+// the distinct blocks of the trace (see analysis.h).
+static void analyze_trace(const options_t *const options,
+                          const uint32_t window) {
+    reject_single_cache_options(options);
+
+    if (options->prefiltered) {
+        printf("The analysis needs every access, so it cannot be "
+               "pre-filtered\n");
         exit(1);
     }
 
-    // argv[0] is program name, parameters start with argv[1]
+    const uint32_t block_bits = (uint32_t)__builtin_ctz(options->block_size);
+    reuse_histogram_t all_reuse;
+    reuse_histogram_t split_reuse[2];
+    reuse_histogram_init(&all_reuse);
+    reuse_histogram_init(&split_reuse[INSTRUCTION]);
+    reuse_histogram_init(&split_reuse[DATA]);
+
+    working_set_t all_blocks;
+    working_set_t split_blocks[2];
+    working_set_init(&all_blocks);
+    working_set_init(&split_blocks[INSTRUCTION]);
+    working_set_init(&split_blocks[DATA]);
+
+    trace_reader_t trace;
+    pipeline_t pipeline;
+    open_input(&trace, &pipeline, options);
+
+    trace_status_t status;
+    uint64_t accesses = 0;
+    uint64_t window_index = 0;
+    uint32_t window_fill = 0;
+
+    printf("window,first_access,accesses,blocks,instruction_blocks,"
+           "data_blocks,bytes\n");
+    do {
+        size_t count;
+        const mem_access_t *const batch =
+            pipeline_next(&pipeline, &count, &status);
+
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t block = batch[i].address >> block_bits;
+            reuse_histogram_add(&all_reuse, block);
+            reuse_histogram_add(&split_reuse[batch[i].accessType], block);
+            working_set_add(&all_blocks, block);
+            working_set_add(&split_blocks[batch[i].accessType], block);
+
+            accesses++;
+            if (++window_fill == window) {
+                print_window(window_index++, accesses - window, window,
+                             options->block_size, &all_blocks, split_blocks);
+                window_fill = 0;
+            }
+        }
+    } while (status == TRACE_OK);
+
+    check_trace_status(status);
+    close_input(&trace, &pipeline);
+
+    // The last window may be partial
+    if (window_fill > 0) {
+        print_window(window_index, accesses - window_fill, window_fill,
+                     options->block_size, &all_blocks, split_blocks);
+    }
+
+    // Print the buckets up to the last one that is used
+    size_t buckets = 0;
+    for (size_t b = 0; b < REUSE_BUCKETS; b++) {
+        if (all_reuse.buckets[b] != 0) {
+            buckets = b + 1;
+        }
+    }
+    printf("\nbucket,min_distance,max_distance,accesses,instruction_accesses,"
+           "data_accesses\n");
+    for (size_t b = 0; b < buckets; b++) {
+        printf("%zu,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+               "\n",
+               b, reuse_bucket_min(b), reuse_bucket_max(b),
+               all_reuse.buckets[b], split_reuse[INSTRUCTION].buckets[b],
+               split_reuse[DATA].buckets[b]);
+    }
+    printf("cold,,,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", all_reuse.cold,
+           split_reuse[INSTRUCTION].cold, split_reuse[DATA].cold);
+
+    reuse_histogram_free(&all_reuse);
+    reuse_histogram_free(&split_reuse[INSTRUCTION]);
+    reuse_histogram_free(&split_reuse[DATA]);
+    working_set_free(&all_blocks);
+    working_set_free(&split_blocks[INSTRUCTION]);
+    working_set_free(&split_blocks[DATA]);
+}
+
+// Parses the levels of a hierarchy, simulates the trace through them and
+// prints the statistics of each level and the average memory access time
+static void simulate_hierarchy(const options_t *const options, const int argc,
+                               const char **const argv) {
+    level_config_t levels[HIERARCHY_MAX_LEVELS];
+    if (argc < 1 || argc > HIERARCHY_MAX_LEVELS) {
+        usage();
+    }
+    reject_single_cache_options(options);
+
+    if (options->prefiltered) {
+        printf("Inclusive levels invalidate blocks in the levels above, so a "
+               "hierarchy cannot be pre-filtered\n");
+        exit(1);
+    }
+    const size_t level_count = (size_t)argc;
+    for (size_t i = 0; i < level_count; i++) {
+        if (parse_level_config(argv[i], i, &levels[i]) < 0) {
+            printf("Invalid cache level: %s\n", argv[i]);
+            exit(1);
+        }
+        levels[i].cache.classify_misses = options->classify;
+        levels[i].cache.write_policy = options->write_policy;
+        levels[i].cache.write_miss = options->write_miss;
+        levels[i].cache.prefetcher = options->prefetcher;
+        levels[i].cache.prefetch_degree = options->prefetch_degree;
+        levels[i].cache.prefetch_latency = options->prefetch_latency;
+        levels[i].cache.block_size = options->block_size;
+        levels[i].cache.address_bits = options->address_bits;
+    }
+    const char *const error = hierarchy_config_error(levels, level_count);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+
+    hierarchy_t hierarchy;
+    if (hierarchy_init(&hierarchy, levels, level_count,
+                       options->memory_latency) < 0) {
+        printf("Unable to allocate the caches\n");
+        exit(1);
+    }
+
+    trace_reader_t trace;
+    pipeline_t pipeline;
+    open_input(&trace, &pipeline, options);
+
+    trace_status_t status;
+
+    do {
+        size_t count;
+        const mem_access_t *const batch =
+            pipeline_next(&pipeline, &count, &status);
+
+        for (size_t i = 0; i < count; i++) {
+            hierarchy_access(&hierarchy, batch[i]);
+        }
+    } while (status == TRACE_OK);
+
+    check_trace_status(status);
+    close_input(&trace, &pipeline);
+
+    printf("%5s %8s %7s %12s %6s %9s %7s %12s %12s %8s %8s %8s\n", "Level",
+           "Size", "Mapping", "Organization", "Policy", "Inclusion", "Latency",
+           "Accesses", "Hits", "Hit Rate", "I Rate", "D Rate");
+    for (size_t i = 0; i < level_count; i++) {
+        const cache_stat_t *const stat = &hierarchy.stats[i];
+        char mapping[16];
+        format_cache_mapping(&levels[i].cache, mapping, sizeof(mapping));
+        printf("%4s%zu %8" PRIu32 " %7s %12s %6s %9s %7" PRIu32 " %12" PRIu64
+               " %12" PRIu64 " %8.4f %8.4f %8.4f\n",
+               "L", i + 1, levels[i].cache.size, mapping,
+               cache_org_name(levels[i].cache.organization),
+               cache_policy_name(&levels[i].cache),
+               i == 0 ? "-" : inclusion_name(hierarchy.inclusion[i]),
+               hierarchy.latency[i], stat->accesses, stat->hits,
+               hit_rate(stat->hits, stat->accesses),
+               hit_rate(stat->instr_hits, stat->instr_accesses),
+               hit_rate(stat->data_hits, stat->data_accesses));
+    }
+
+    printf("\nMemory Accesses: %" PRIu64 "\n", hierarchy.memory_accesses);
+    printf("Back Invalidations: %" PRIu64 "\n", hierarchy.back_invalidations);
+    printf("AMAT: %.2f cycles\n", hierarchy_amat(&hierarchy));
+
+    hierarchy_free(&hierarchy);
+}
+
+// Parses the cache of every core, simulates each trace on its own core with
+// caches kept coherent by MESI and prints the statistics of each core and the
+// bus traffic
+static void simulate_coherent_cores(const options_t *const options,
+                                    const int argc, const char **const argv) {
+    if (argc < 2 || argc - 1 > COHERENCE_MAX_CORES) {
+        usage();
+    }
+    reject_single_cache_options(options);
+
+    if (options->prefiltered) {
+        printf("Another core can invalidate a block between two accesses, so "
+               "coherent caches cannot be pre-filtered\n");
+        exit(1);
+    }
+    const size_t cores = (size_t)argc - 1;
+
+    cache_config_t config;
+    if (parse_cache_config(argv[0], &config) < 0) {
+        printf("Invalid cache configuration: %s\n", argv[0]);
+        exit(1);
+    }
+    config.classify_misses = options->classify;
+    config.write_policy = options->write_policy;
+    config.write_miss = options->write_miss;
+    config.prefetcher = options->prefetcher;
+    config.prefetch_degree = options->prefetch_degree;
+    config.prefetch_latency = options->prefetch_latency;
+    config.block_size = options->block_size;
+    config.address_bits = options->address_bits;
+    const char *error = cache_config_error(&config);
+    if (error == NULL) {
+        error = coherence_config_error(&config);
+    }
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+
+    // Only one trace can come from standard input
+    int stdin_traces = 0;
+    for (size_t c = 0; c < cores; c++) {
+        stdin_traces += strcmp(argv[c + 1], "-") == 0;
+    }
+    if (stdin_traces > 1) {
+        printf("Only one trace can be read from standard input\n");
+        exit(1);
+    }
+
+    trace_reader_t traces[COHERENCE_MAX_CORES];
+    for (size_t c = 0; c < cores; c++) {
+        open_trace_path(&traces[c], argv[c + 1], options);
+    }
+
+    cache_stat_t stats[COHERENCE_MAX_CORES];
+    coherence_stat_t coherence[COHERENCE_MAX_CORES];
+    memset(stats, 0, sizeof(stats));
+    memset(coherence, 0, sizeof(coherence));
+    trace_status_t status;
+    if (simulate_coherent(&config, traces, cores, options->threads, stats,
+                          coherence, &status) < 0) {
+        printf("Unable to allocate the coherent caches\n");
+        exit(1);
+    }
+
+    check_trace_status(status);
+    for (size_t c = 0; c < cores; c++) {
+        trace_close(&traces[c]);
+    }
+
+    printf("%4s %12s %12s %8s %16s %13s %10s %16s\n", "Core", "Accesses",
+           "Hits", "Hit Rate", "Coherence Misses", "Invalidations",
+           "Writebacks", "Bus Transactions");
+    cache_stat_t total_stat;
+    coherence_stat_t total = {0};
+    memset(&total_stat, 0, sizeof(cache_stat_t));
+    for (size_t c = 0; c < cores; c++) {
+        const cache_stat_t *const stat = &stats[c];
+        printf("%4zu %12" PRIu64 " %12" PRIu64 " %8.4f %16" PRIu64
+               " %13" PRIu64 " %10" PRIu64 " %16" PRIu64 "\n",
+               c, stat->accesses, stat->hits,
+               hit_rate(stat->hits, stat->accesses),
+               coherence[c].coherence_misses, coherence[c].invalidations,
+               stat->writebacks, coherence_bus_transactions(&coherence[c]));
+
+        cache_stat_add(&total_stat, stat);
+        total.bus_reads += coherence[c].bus_reads;
+        total.bus_read_exclusives += coherence[c].bus_read_exclusives;
+        total.bus_upgrades += coherence[c].bus_upgrades;
+        total.bus_writebacks += coherence[c].bus_writebacks;
+        total.invalidations += coherence[c].invalidations;
+        total.coherence_misses += coherence[c].coherence_misses;
+    }
+    printf("%4s %12" PRIu64 " %12" PRIu64 " %8.4f %16" PRIu64 " %13" PRIu64
+           " %10" PRIu64 " %16" PRIu64 "\n",
+           "All", total_stat.accesses, total_stat.hits,
+           hit_rate(total_stat.hits, total_stat.accesses),
+           total.coherence_misses, total.invalidations,
+           total_stat.writebacks, coherence_bus_transactions(&total));
+
+    printf("\nBus Reads: %" PRIu64 "\n", total.bus_reads);
+    printf("Bus Read-Exclusives: %" PRIu64 "\n", total.bus_read_exclusives);
+    printf("Bus Upgrades: %" PRIu64 "\n", total.bus_upgrades);
+    printf("Bus Writebacks: %" PRIu64 "\n", total.bus_writebacks);
+    printf("Bus Transactions: %" PRIu64 "\n",
+           coherence_bus_transactions(&total));
+}
+
+int main(const int argc, const char **argv) {
+    cache_config_t config;
+    options_t options = {.trace_path = "mem_trace.txt",
+                         .threads = pool_default_threads(),
+                         .pipelined = 0,
+                         .verbose = 0,
+                         .memory_latency = DEFAULT_MEMORY_LATENCY,
+                         .classify = 0,
+                         .sharded = 0,
+                         .telemetry_interval = 0,
+                         .telemetry_fd = STDERR_FILENO,
+                         .telemetry_format = TELEMETRY_CSV,
+                         .checkpoint_path = NULL,
+                         .checkpoint_interval = 0,
+                         .resume_path = NULL,
+                         .write_policy = WRITE_BACK,
+                         .write_miss = WRITE_ALLOCATE,
+                         .prefetcher = NULL,
+                         .prefetch_degree = 0,
+                         .prefetch_latency = PREFETCH_DEFAULT_LATENCY,
+                         .block_size = DEFAULT_BLOCK_SIZE,
+                         .address_bits = DEFAULT_ADDRESS_BITS,
+                         .prefiltered = 0};
+
+    // Read command-line parameters and initialize the cache configuration
+
+    // argv[0] is program name, options start with argv[1] and come before the
+    // parameters
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-') {
+        if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc) {
+            options.trace_path = argv[arg + 1];
+            arg += 2;
+        } else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+            uint32_t count;
+            if (parse_cache_size(argv[arg + 1], &count) < 0) {
+                usage();
+            }
+            options.threads = count;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-p") == 0) {
+            options.pipelined = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "-v") == 0) {
+            options.verbose = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "-m") == 0 && arg + 1 < argc) {
+            if (parse_cache_size(argv[arg + 1], &options.memory_latency) < 0) {
+                usage();
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "-c") == 0) {
+            options.classify = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "-s") == 0) {
+            options.sharded = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "-i") == 0 && arg + 1 < argc) {
+            uint32_t interval;
+            if (parse_cache_size(argv[arg + 1], &interval) < 0) {
+                usage();
+            }
+            options.telemetry_interval = interval;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-d") == 0 && arg + 1 < argc) {
+            uint32_t fd;
+            if (parse_cache_size(argv[arg + 1], &fd) < 0 || fd > INT32_MAX) {
+                usage();
+            }
+            options.telemetry_fd = (int)fd;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-f") == 0 && arg + 1 < argc) {
+            if (parse_telemetry_format(argv[arg + 1],
+                                       &options.telemetry_format) < 0) {
+                usage();
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+            if (parse_write_policy(argv[arg + 1], &options.write_policy) < 0) {
+                usage();
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "-a") == 0 && arg + 1 < argc) {
+            if (parse_write_miss(argv[arg + 1], &options.write_miss) < 0) {
+                usage();
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "-P") == 0 && arg + 1 < argc) {
+            if (parse_prefetcher(argv[arg + 1], &options.prefetcher,
+                                 &options.prefetch_degree) < 0) {
+                usage();
+            }
+            arg += 2;
+        } else if (strcmp(argv[arg], "-L") == 0 && arg + 1 < argc) {
+            uint32_t latency;
+            if (parse_cache_size(argv[arg + 1], &latency) < 0) {
+                usage();
+            }
+            options.prefetch_latency = latency;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-b") == 0 && arg + 1 < argc) {
+            uint32_t block_size;
+            if (parse_cache_size(argv[arg + 1], &block_size) < 0 ||
+                (block_size & (block_size - 1)) != 0 ||
+                block_size < STORE_SIZE) {
+                usage();
+            }
+            options.block_size = block_size;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-A") == 0 && arg + 1 < argc) {
+            uint32_t bits;
+            if (parse_cache_size(argv[arg + 1], &bits) < 0 ||
+                bits > MAX_ADDRESS_BITS) {
+                usage();
+            }
+            options.address_bits = bits;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-e") == 0) {
+            options.prefiltered = 1;
+            arg++;
+        } else if (strcmp(argv[arg], "-k") == 0 && arg + 1 < argc) {
+            options.checkpoint_path = argv[arg + 1];
+            arg += 2;
+        } else if (strcmp(argv[arg], "-K") == 0 && arg + 1 < argc) {
+            uint32_t interval;
+            if (parse_cache_size(argv[arg + 1], &interval) < 0) {
+                usage();
+            }
+            options.checkpoint_interval = interval;
+            arg += 2;
+        } else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc) {
+            options.resume_path = argv[arg + 1];
+            arg += 2;
+        } else if (strcmp(argv[arg], "--sweep") == 0) {
+            // The rest of the arguments are the configurations to sweep
+            sweep(&options, argc - arg - 1, argv + arg + 1);
+            return 0;
+        } else if (strcmp(argv[arg], "--stack-distance") == 0) {
+            uint32_t max_size = CURVE_MAX_SIZE;
+            if (argc - arg > 2 ||
+                (argc - arg == 2 &&
+                 (parse_cache_size(argv[arg + 1], &max_size) < 0 ||
+                  max_size / 2 < options.block_size))) {
+                usage();
+            }
+            stack_distance_curve(&options, max_size);
+            return 0;
+        } else if (strcmp(argv[arg], "--analyze") == 0) {
+            uint32_t window = DEFAULT_ANALYSIS_WINDOW;
+            if (argc - arg > 2 ||
+                (argc - arg == 2 &&
+                 parse_cache_size(argv[arg + 1], &window) < 0)) {
+                usage();
+            }
+            analyze_trace(&options, window);
+            return 0;
+        } else if (strcmp(argv[arg], "--hierarchy") == 0) {
+            // The rest of the arguments are the levels, from the first
+            simulate_hierarchy(&options, argc - arg - 1, argv + arg + 1);
+            return 0;
+        } else if (strcmp(argv[arg], "--coherent") == 0) {
+            // The rest of the arguments are the cache and the core traces
+            simulate_coherent_cores(&options, argc - arg - 1, argv + arg + 1);
+            return 0;
+        } else {
+            usage();
+        }
+    }
+
+    // There should be 3 or 4 parameters after the options
+    if (argc - arg != 3 && argc - arg != 4) {
+        usage();
+    }
+    const int params = argc - arg;
+    argv += arg - 1;
 
     // Set cache size
-    cache_size = (uint32_t)strtoul(argv[1], NULL, 10);
+    if (parse_cache_size(argv[1], &config.size) < 0) {
+        printf("Invalid cache size\n");
+        exit(1);
+    }
+
+    config.classify_misses = options.classify;
+    config.write_policy = options.write_policy;
+    config.write_miss = options.write_miss;
+    config.prefetcher = options.prefetcher;
+    config.prefetch_degree = options.prefetch_degree;
+    config.prefetch_latency = options.prefetch_latency;
+    config.block_size = options.block_size;
+    config.address_bits = options.address_bits;
 
     // Set cache mapping
-    if (strcmp(argv[2], "dm") == 0) {
-        cache_mapping = DIRECT_MAPPING;
-    } else if (strcmp(argv[2], "fa") == 0) {
-        cache_mapping = FULLY_ASSOCIATIVE;
-    } else {
+    config.ways = 0;
+    if (parse_cache_mapping(argv[2], &config.mapping, &config.ways) < 0) {
         printf("Unknown cache mapping\n");
         exit(1);
     }
 
     // Set cache organization
-    if (strcmp(argv[3], "uc") == 0) {
-        cache_org = UNIFIED;
-    } else if (strcmp(argv[3], "sc") == 0) {
-        cache_org = SPLIT;
-    } else {
+    if (parse_cache_org(argv[3], &config.organization) < 0) {
         printf("Unknown cache organization\n");
         exit(1);
     }
 
-    // Create the cache context from the user input
-    const cache_context_t cache_ctx =
-        create_context(cache_size, cache_mapping, cache_org);
+    // Set the replacement policy
+    if (parse_cache_policy(params == 4 ? argv[4] : NULL, &config) < 0) {
+        printf("Unknown replacement policy\n");
+        exit(1);
+    }
 
-    // Open the file mem_trace.txt to read memory accesses
-    FILE *ptr_file = fopen("mem_trace.txt", "r");
-    if (!ptr_file) {
-        printf("Unable to open the trace file\n");
+    const char *const error = cache_config_error(&config);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+
+    if (options.sharded && config.mapping == FULLY_ASSOCIATIVE) {
+        printf("Only Direct Mapped and Set Associative caches can be split "
+               "by set\n");
+        exit(1);
+    }
+    if (options.sharded && options.classify) {
+        printf("Classifying misses needs the whole cache, so it cannot be "
+               "split by set\n");
+        exit(1);
+    }
+    if (options.sharded && options.prefetcher != NULL) {
+        printf("Prefetches cross sets, so a cache with a prefetcher cannot be "
+               "split by set\n");
+        exit(1);
+    }
+    if (options.sharded && options.verbose) {
+        printf("The sets are simulated out of trace order, so the accesses of "
+               "a cache split by set are not printed\n");
+        exit(1);
+    }
+    if (options.sharded && options.telemetry_interval != 0) {
+        printf("The sets are simulated out of trace order, so a cache split "
+               "by set has no telemetry\n");
+        exit(1);
+    }
+    if (options.sharded &&
+        (options.checkpoint_path != NULL || options.resume_path != NULL ||
+         options.checkpoint_interval != 0)) {
+        printf("The sets are simulated out of trace order, so a cache split "
+               "by set cannot be checkpointed\n");
         exit(1);
     }
 
+    // Create the simulation from the user input
+    cachesim_t *const sim = create_simulation(&config, options.prefiltered);
+
     cache_stat_t cache_stat;
-    memset(&cache_stat, 0, sizeof(cache_stat_t));
-
-    // Loop until whole trace file has been read
-    while (1) {
-        const mem_access_t access = read_transaction(ptr_file);
-        // If no transactions left, break out of loop
-        if (access.address == 0) {
-            break;
+    trace_status_t status;
+
+    if (options.sharded) {
+        trace_reader_t trace;
+        open_trace(&trace, &options);
+
+        size_t access_count;
+        mem_access_t *const accesses =
+            trace_read_all(&trace, &access_count, &status);
+        if (accesses == NULL) {
+            printf("Unable to allocate the trace\n");
+            exit(1);
+        }
+        check_trace_status(status);
+        trace_close(&trace);
+
+        if (cachesim_feed_sharded(sim, accesses, access_count,
+                                  options.threads) < 0) {
+            printf(
+                "Unable to allocate the memory or start the worker threads\n");
+            exit(1);
+        }
+        free(accesses);
+    } else {
+        // Open the trace file to read memory accesses
+        trace_reader_t trace;
+        pipeline_t pipeline;
+        open_trace(&trace, &options);
+
+        // Restore the caches and statistics of an earlier run and continue
+        // the trace where it stopped
+        if (options.resume_path != NULL) {
+            trace_position_t position;
+            if (cachesim_load(sim, options.resume_path, &position) < 0) {
+                printf("Unable to resume from the checkpoint\n");
+                exit(1);
+            }
+            if (trace_seek(&trace, position) < 0) {
+                printf("The checkpoint is past the end of the trace file\n");
+                exit(1);
+            }
         }
+        pipeline_open(&pipeline, &trace, options.pipelined);
+        cachesim_stats(sim, &cache_stat);
+        uint64_t checkpoint_accesses = cache_stat.accesses;
+        const uint32_t checkpoint_interval =
+            options.checkpoint_interval != 0 ? options.checkpoint_interval
+                                             : DEFAULT_CHECKPOINT_INTERVAL;
 
-        printf("%d %x\n", access.accessType, access.address);
+        // Start writing statistics snapshots if they were asked for
+        telemetry_t telemetry;
+        telemetry_t *const snapshots =
+            options.telemetry_interval != 0 ? &telemetry : NULL;
+        if (snapshots != NULL &&
+            telemetry_open(snapshots, options.telemetry_fd,
+                           options.telemetry_format,
+                           options.telemetry_interval, &cache_stat) < 0) {
+            printf("Unable to write the telemetry\n");
+            exit(1);
+        }
 
-        // Perform a cache read
-        cache_read(cache_ctx, access, &cache_stat);
+        // Loop until whole trace file has been read
+        do {
+            size_t count;
+            const mem_access_t *const batch =
+                pipeline_next(&pipeline, &count, &status);
+
+            if (options.verbose) {
+                for (size_t i = 0; i < count; i++) {
+                    printf("%d %" PRIx64 "\n", batch[i].accessType,
+                           batch[i].address);
+                }
+            }
+
+            // Perform the cache reads
+            simulate_batch(sim, batch, count, snapshots);
+
+            // Checkpoint between batches, where the position in the trace is
+            // known
+            cachesim_stats(sim, &cache_stat);
+            if (options.checkpoint_path != NULL && status == TRACE_OK &&
+                cache_stat.accesses - checkpoint_accesses >=
+                    checkpoint_interval) {
+                if (cachesim_save(sim, options.checkpoint_path,
+                                  pipeline_position(&pipeline)) < 0) {
+                    printf("Unable to write the checkpoint\n");
+                    exit(1);
+                }
+                checkpoint_accesses = cache_stat.accesses;
+            }
+        } while (status == TRACE_OK);
+
+        check_trace_status(status);
+        close_input(&trace, &pipeline);
+        if (snapshots != NULL) {
+            telemetry_close(snapshots, &cache_stat);
+        }
     }
 
+    check_trace_status(status);
+    cachesim_stats(sim, &cache_stat);
+
     // Print the statistics
     // DO NOT CHANGE THE FOLLOWING LINES!
     printf("\nCache Statistics\n");
@@ -280,7 +1251,7 @@ int main(const int argc, const char **argv) {
            (double)cache_stat.hits / (double)cache_stat.accesses);
     // You can extend the memory statistic printing if you like!
 
-    if (cache_ctx.organization == SPLIT) {
+    if (config.organization == SPLIT) {
         printf("\nInstruction Cache Accesses: %lu\n",
                cache_stat.instr_accesses);
         printf("Instruction Cache Hits: %lu\n", cache_stat.instr_hits);
@@ -294,18 +1265,38 @@ int main(const int argc, const char **argv) {
                (double)cache_stat.data_hits / (double)cache_stat.data_accesses);
     }
 
-    printf("-----------------\n");
-
-    // Close the trace file
-    fclose(ptr_file);
+    if (config.classify_misses) {
+        printf("\nCompulsory Misses: %" PRIu64 "\n",
+               cache_stat.compulsory_misses);
+        printf("Capacity Misses: %" PRIu64 "\n", cache_stat.capacity_misses);
+        printf("Conflict Misses: %" PRIu64 "\n", cache_stat.conflict_misses);
+    }
 
-    free(cache_ctx.instr_cache->lines);
-    free(cache_ctx.instr_cache);
+    // The traffic to the next level only depends on the write policies when
+    // the trace has stores, or on the prefetcher
+    if (cache_stat.writes > 0 || config.prefetcher != NULL) {
+        printf("\nWrites: %" PRIu64 "\n", cache_stat.writes);
+        printf("Writebacks: %" PRIu64 "\n", cache_stat.writebacks);
+        printf("Bytes Read: %" PRIu64 "\n", cache_stat.bytes_read);
+        printf("Bytes Written: %" PRIu64 "\n", cache_stat.bytes_written);
+    }
 
-    if (cache_ctx.organization == SPLIT) {
-        free(cache_ctx.data_cache->lines);
-        free(cache_ctx.data_cache);
+    if (config.prefetcher != NULL) {
+        printf("\nPrefetches Issued: %" PRIu64 "\n",
+               cache_stat.prefetches_issued);
+        printf("Prefetches Useful: %" PRIu64 "\n",
+               cache_stat.prefetches_useful);
+        printf("Prefetches Late: %" PRIu64 "\n", cache_stat.prefetches_late);
+        printf("Prefetches Polluting: %" PRIu64 "\n",
+               cache_stat.prefetches_polluting);
+        printf("Prefetch Accuracy: %.4f\n",
+               hit_rate(cache_stat.prefetches_useful,
+                        cache_stat.prefetches_issued));
     }
 
+    printf("-----------------\n");
+
+    cachesim_destroy(sim);
+
     return 0;
 }
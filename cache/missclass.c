@@ -0,0 +1,163 @@
+#include "missclass.h"
+
+#include <stdlib.h>
+
+// The initial number of hash map entries
+enum { INITIAL_CAPACITY = 1 << 12 };
+
+// Returns the index of `key` in the hash map, or of the empty entry where it
+// would be inserted
+static size_t map_find(const miss_classifier_t *const classifier,
+                       const uint64_t key) {
+    const size_t mask = classifier->map_capacity - 1;
+    size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+    while (classifier->keys[i] != 0 && classifier->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Doubles the size of the hash map. Returns 0 on success, or -1 if the larger
+// map cannot be allocated, in which case the old one is kept.
+static int map_grow(miss_classifier_t *const classifier) {
+    uint64_t *const old_keys = classifier->keys;
+    uint32_t *const old_lines = classifier->lines;
+    const size_t old_capacity = classifier->map_capacity;
+
+    uint64_t *const keys = calloc(2 * old_capacity, sizeof(uint64_t));
+    uint32_t *const lines = malloc(2 * old_capacity * sizeof(uint32_t));
+    if (keys == NULL || lines == NULL) {
+        free(keys);
+        free(lines);
+        return -1;
+    }
+    classifier->map_capacity = 2 * old_capacity;
+    classifier->keys = keys;
+    classifier->lines = lines;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != 0) {
+            const size_t j = map_find(classifier, old_keys[i]);
+            classifier->keys[j] = old_keys[i];
+            classifier->lines[j] = old_lines[i];
+        }
+    }
+
+    free(old_keys);
+    free(old_lines);
+    return 0;
+}
+
+// Removes shadow line `line` from the recency list
+static void list_unlink(miss_classifier_t *const classifier,
+                        const uint32_t line) {
+    const uint32_t prev = classifier->prev[line];
+    const uint32_t next = classifier->next[line];
+    if (prev == MISS_NO_LINE) {
+        classifier->head = next;
+    } else {
+        classifier->next[prev] = next;
+    }
+    if (next == MISS_NO_LINE) {
+        classifier->tail = prev;
+    } else {
+        classifier->prev[next] = prev;
+    }
+}
+
+// Inserts shadow line `line` at the most recently used end of the list
+static void list_push_front(miss_classifier_t *const classifier,
+                            const uint32_t line) {
+    classifier->prev[line] = MISS_NO_LINE;
+    classifier->next[line] = classifier->head;
+    if (classifier->head == MISS_NO_LINE) {
+        classifier->tail = line;
+    } else {
+        classifier->prev[classifier->head] = line;
+    }
+    classifier->head = line;
+}
+
+int miss_classifier_init(miss_classifier_t *const classifier,
+                         const uint32_t lines) {
+    classifier->map_capacity = INITIAL_CAPACITY;
+    classifier->map_count = 0;
+    classifier->keys = calloc(classifier->map_capacity, sizeof(uint64_t));
+    classifier->lines = malloc(classifier->map_capacity * sizeof(uint32_t));
+
+    classifier->blocks = malloc(lines * sizeof(uint64_t));
+    classifier->prev = malloc(lines * sizeof(uint32_t));
+    classifier->next = malloc(lines * sizeof(uint32_t));
+    classifier->capacity = lines;
+    classifier->used = 0;
+    classifier->head = MISS_NO_LINE;
+    classifier->tail = MISS_NO_LINE;
+    classifier->failed = 0;
+
+    if (classifier->keys == NULL || classifier->lines == NULL ||
+        classifier->blocks == NULL || classifier->prev == NULL ||
+        classifier->next == NULL) {
+        miss_classifier_free(classifier);
+        return -1;
+    }
+    return 0;
+}
+
+void miss_classifier_free(miss_classifier_t *const classifier) {
+    free(classifier->keys);
+    free(classifier->lines);
+    free(classifier->blocks);
+    free(classifier->prev);
+    free(classifier->next);
+}
+
+miss_class_t miss_classify(miss_classifier_t *const classifier,
+                           const uint64_t block, const int hit) {
+    // Zero marks an empty hash map entry and a block outside the shadow cache
+    const uint64_t key = block + 1;
+
+    // Grow first, so the entry found below stays valid. Without the memory
+    // to remember a new block, the classification stops.
+    if (classifier->failed) {
+        return hit ? MISS_NONE : MISS_COMPULSORY;
+    }
+    if (2 * (classifier->map_count + 1) > classifier->map_capacity &&
+        map_grow(classifier) < 0) {
+        classifier->failed = 1;
+        return hit ? MISS_NONE : MISS_COMPULSORY;
+    }
+
+    const size_t i = map_find(classifier, key);
+    miss_class_t miss_class;
+    uint32_t line;
+
+    if (classifier->keys[i] == 0) {
+        classifier->keys[i] = key;
+        classifier->lines[i] = 0;
+        classifier->map_count++;
+        miss_class = MISS_COMPULSORY;
+    } else if (classifier->lines[i] == 0) {
+        miss_class = MISS_CAPACITY;
+    } else {
+        // A shadow hit only moves the line to the front
+        line = classifier->lines[i] - 1;
+        list_unlink(classifier, line);
+        list_push_front(classifier, line);
+        return hit ? MISS_NONE : MISS_CONFLICT;
+    }
+
+    // The block enters the shadow cache, evicting its least recently used
+    // block when it is full
+    if (classifier->used < classifier->capacity) {
+        line = classifier->used++;
+    } else {
+        line = classifier->tail;
+        list_unlink(classifier, line);
+        classifier->lines[map_find(classifier, classifier->blocks[line] + 1)] =
+            0;
+    }
+    classifier->blocks[line] = block;
+    classifier->lines[i] = line + 1;
+    list_push_front(classifier, line);
+
+    return hit ? MISS_NONE : miss_class;
+}
@@ -0,0 +1,68 @@
+#ifndef MISSCLASS_H
+#define MISSCLASS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Why an access missed (Hill's 3C model)
+typedef enum {
+    // The access hit
+    MISS_NONE,
+    // The block was never accessed before
+    MISS_COMPULSORY,
+    // The access would also miss in a fully associative LRU cache of the same
+    // size
+    MISS_CAPACITY,
+    // The access would hit in a fully associative LRU cache of the same size,
+    // so it only missed because of the mapping or replacement policy
+    MISS_CONFLICT,
+} miss_class_t;
+
+// Marks the end of the recency list of a classifier
+#define MISS_NO_LINE UINT32_MAX
+
+// Classifies the misses of a cache. It remembers every block that was ever
+// accessed, and keeps a shadow fully associative LRU cache with as many lines
+// as the real one. Both live in one hash map from block to shadow line, and
+// the shadow lines form a doubly linked list in recency order, so each access
+// costs O(1).
+typedef struct {
+    // Open addressing hash map from block (plus one) to its shadow line (plus
+    // one), or to zero if the block is not in the shadow cache
+    uint64_t *keys;
+    uint32_t *lines;
+    // The size of the hash map, a power of two
+    size_t map_capacity;
+    // The number of blocks in the hash map
+    size_t map_count;
+
+    // The block in each shadow line
+    uint64_t *blocks;
+    // The more and less recently used neighbours of each shadow line
+    uint32_t *prev;
+    uint32_t *next;
+    // The number of shadow lines, and how many of them are in use
+    uint32_t capacity;
+    uint32_t used;
+    // The most and least recently used shadow lines
+    uint32_t head;
+    uint32_t tail;
+    // Set once the hash map could not grow, after which the misses are no
+    // longer classified correctly
+    int failed;
+} miss_classifier_t;
+
+// Initializes a classifier for a cache with `lines` lines. Returns 0 on
+// success, or -1 if its memory cannot be allocated.
+int miss_classifier_init(miss_classifier_t *classifier, uint32_t lines);
+
+// Frees the memory of a classifier
+void miss_classifier_free(miss_classifier_t *classifier);
+
+// Records an access to `block` that hit in the real cache if `hit` is set, and
+// returns why it missed, or MISS_NONE if it hit. If the hash map cannot grow,
+// `failed` is set and every later miss is reported as compulsory.
+miss_class_t miss_classify(miss_classifier_t *classifier, uint64_t block,
+                           int hit);
+
+#endif
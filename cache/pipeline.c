@@ -0,0 +1,117 @@
+#define _DEFAULT_SOURCE
+
+#include "pipeline.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+// The number of times to poll the ring before yielding the processor
+enum { SPIN_LIMIT = 64 };
+
+// Waits a little while another thread makes progress on the ring
+static void backoff(unsigned *const spins) {
+    if (++*spins >= SPIN_LIMIT) {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+static void *decoder_main(void *const arg) {
+    pipeline_t *const pipeline = arg;
+    size_t head = atomic_load_explicit(&pipeline->head, memory_order_relaxed);
+    trace_status_t status;
+
+    do {
+        // Wait for the consumer to release a slot
+        unsigned spins = 0;
+        while (head - atomic_load_explicit(&pipeline->tail,
+                                           memory_order_acquire) ==
+               PIPELINE_SLOTS) {
+            if (atomic_load_explicit(&pipeline->stop, memory_order_relaxed)) {
+                return NULL;
+            }
+            backoff(&spins);
+        }
+
+        pipeline_batch_t *const batch =
+            &pipeline->slots[head % PIPELINE_SLOTS];
+        batch->count = trace_read_batch(pipeline->reader, batch->accesses,
+                                        PIPELINE_BATCH_SIZE, &status);
+        batch->status = status;
+        batch->position = trace_tell(pipeline->reader);
+
+        // Publish the batch to the consumer
+        head++;
+        atomic_store_explicit(&pipeline->head, head, memory_order_release);
+    } while (status == TRACE_OK);
+
+    return NULL;
+}
+
+void pipeline_open(pipeline_t *const pipeline, trace_reader_t *const reader,
+                   const int threaded) {
+    pipeline->reader = reader;
+    pipeline->slots =
+        malloc((threaded ? PIPELINE_SLOTS : 1) * sizeof(pipeline_batch_t));
+    atomic_init(&pipeline->head, 0);
+    atomic_init(&pipeline->tail, 0);
+    atomic_init(&pipeline->stop, 0);
+    pipeline->holding = 0;
+    pipeline->position = trace_tell(reader);
+    pipeline->threaded = 0;
+
+    if (threaded &&
+        pthread_create(&pipeline->thread, NULL, decoder_main, pipeline) == 0) {
+        pipeline->threaded = 1;
+    }
+}
+
+const mem_access_t *pipeline_next(pipeline_t *const pipeline,
+                                  size_t *const count,
+                                  trace_status_t *const status) {
+    if (!pipeline->threaded) {
+        pipeline_batch_t *const batch = &pipeline->slots[0];
+        *count = trace_read_batch(pipeline->reader, batch->accesses,
+                                  PIPELINE_BATCH_SIZE, status);
+        pipeline->position = trace_tell(pipeline->reader);
+        return batch->accesses;
+    }
+
+    size_t tail = atomic_load_explicit(&pipeline->tail, memory_order_relaxed);
+    if (pipeline->holding) {
+        // Hand the previous batch back to the producer
+        tail++;
+        atomic_store_explicit(&pipeline->tail, tail, memory_order_release);
+    }
+
+    // Wait for the producer to publish a batch
+    unsigned spins = 0;
+    while (atomic_load_explicit(&pipeline->head, memory_order_acquire) ==
+           tail) {
+        backoff(&spins);
+    }
+
+    const pipeline_batch_t *const batch =
+        &pipeline->slots[tail % PIPELINE_SLOTS];
+    pipeline->holding = 1;
+    *count = batch->count;
+    *status = batch->status;
+    pipeline->position = batch->position;
+    return batch->accesses;
+}
+
+trace_position_t pipeline_position(const pipeline_t *const pipeline) {
+    return pipeline->position;
+}
+
+void pipeline_close(pipeline_t *const pipeline) {
+    if (pipeline->threaded) {
+        // The decoder may still be waiting for a free slot if the consumer
+        // stopped before the end of the trace
+        atomic_store_explicit(&pipeline->stop, 1, memory_order_relaxed);
+        pthread_join(pipeline->thread, NULL);
+    }
+
+    free(pipeline->slots);
+    pipeline->slots = NULL;
+}
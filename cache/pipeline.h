@@ -0,0 +1,69 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "trace.h"
+
+// The number of accesses in each batch of the ring
+enum { PIPELINE_BATCH_SIZE = 16384 };
+// The number of batches in the ring, a power of two
+enum { PIPELINE_SLOTS = 8 };
+
+// A batch of decoded accesses in the ring
+typedef struct {
+    mem_access_t accesses[PIPELINE_BATCH_SIZE];
+    // The number of accesses in the batch
+    size_t count;
+    // TRACE_OK, or why decoding stopped after this batch
+    trace_status_t status;
+    // The position in the trace after the batch
+    trace_position_t position;
+} pipeline_batch_t;
+
+// Reads batches of accesses from a trace. When it is threaded, a decoder
+// thread fills a lock-free single-producer, single-consumer ring of batches
+// ahead of the consumer, so decoding overlaps with simulation. Otherwise the
+// batches are decoded on demand by the consumer.
+typedef struct {
+    // The trace to decode
+    trace_reader_t *reader;
+    // The ring of batches
+    pipeline_batch_t *slots;
+    // The number of batches the producer has filled
+    _Atomic size_t head;
+    // The number of batches the consumer has released
+    _Atomic size_t tail;
+    // Set by the consumer to stop the decoder early
+    atomic_int stop;
+    // Whether the consumer holds the batch at `tail`
+    int holding;
+    // The position in the trace after the batch the consumer holds. The
+    // decoder thread reads ahead, so the reader's own position is further on.
+    trace_position_t position;
+    // Whether a decoder thread fills the ring
+    int threaded;
+    // The decoder thread
+    pthread_t thread;
+} pipeline_t;
+
+// Starts reading `reader`, on a decoder thread if `threaded` is set. Falls
+// back to decoding on demand if the thread cannot be started.
+void pipeline_open(pipeline_t *pipeline, trace_reader_t *reader, int threaded);
+
+// Returns the next batch of accesses and sets `count` to its size. `status`
+// is set like trace_read_batch() does. The batch stays valid until the next
+// call.
+const mem_access_t *pipeline_next(pipeline_t *pipeline, size_t *count,
+                                  trace_status_t *status);
+
+// Returns the position in the trace after the last batch returned by
+// pipeline_next(), where reading can resume once that batch is consumed
+trace_position_t pipeline_position(const pipeline_t *pipeline);
+
+// Stops the decoder thread and frees the ring
+void pipeline_close(pipeline_t *pipeline);
+
+#endif
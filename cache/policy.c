@@ -0,0 +1,190 @@
+#include "policy.h"
+
+#include <string.h>
+
+// LRU keeps the recency rank of every way in one byte, where 0 is the most
+// recently used way
+
+static size_t lru_state_size(const uint32_t ways) { return ways; }
+
+static void lru_init(uint8_t *const state, const uint32_t ways) {
+    for (uint32_t way = 0; way < ways; way++) {
+        state[way] = (uint8_t)way;
+    }
+}
+
+static void lru_touch(uint8_t *const state, const uint32_t ways,
+                      const uint32_t way) {
+    const uint8_t rank = state[way];
+    for (uint32_t w = 0; w < ways; w++) {
+        if (state[w] < rank) {
+            state[w]++;
+        }
+    }
+    state[way] = 0;
+}
+
+static uint32_t lru_victim(uint8_t *const state, const uint32_t ways) {
+    uint32_t way = 0;
+    while (state[way] != ways - 1) {
+        way++;
+    }
+    return way;
+}
+
+const replacement_policy_t policy_lru = {
+    .name = "lru",
+    .state_size = lru_state_size,
+    .init = lru_init,
+    .hit = lru_touch,
+    .victim = lru_victim,
+    .fill = lru_touch,
+    .fill_is_hit = 1,
+};
+
+// FIFO keeps the fill rank of every way in the same layout as LRU, where 0 is
+// the most recently filled way. Only fills move a way to the front, so a way
+// that was invalidated and refilled joins the back of the queue instead of
+// reordering it.
+
+static void fifo_hit(uint8_t *const state, const uint32_t ways,
+                     const uint32_t way) {
+    (void)state;
+    (void)ways;
+    (void)way;
+}
+
+const replacement_policy_t policy_fifo = {
+    .name = "fifo",
+    .state_size = lru_state_size,
+    .init = lru_init,
+    .hit = fifo_hit,
+    .victim = lru_victim,
+    .fill = lru_touch,
+    .fill_is_hit = 1,
+};
+
+// Tree-PLRU keeps one bit per inner node of a binary tree over the ways,
+// stored in heap order with the root in bit 0. A bit set to one means the
+// pseudo least recently used way is in the right subtree.
+
+static size_t plru_state_size(const uint32_t ways) {
+    return (ways - 1 + 7) / 8;
+}
+
+static void plru_init(uint8_t *const state, const uint32_t ways) {
+    (void)state;
+    (void)ways;
+}
+
+static void plru_touch(uint8_t *const state, const uint32_t ways,
+                       const uint32_t way) {
+    uint32_t node = 0;
+    // Walk from the root to the way and point every node away from it
+    for (uint32_t half = ways / 2; half > 0; half /= 2) {
+        const uint32_t right = (way & half) != 0;
+        if (right) {
+            state[node / 8] &= (uint8_t)~(1U << (node % 8));
+        } else {
+            state[node / 8] |= (uint8_t)(1U << (node % 8));
+        }
+        node = 2 * node + 1 + right;
+    }
+}
+
+static uint32_t plru_victim(uint8_t *const state, const uint32_t ways) {
+    uint32_t node = 0;
+    uint32_t way = 0;
+    for (uint32_t half = ways / 2; half > 0; half /= 2) {
+        const uint32_t right = (state[node / 8] >> (node % 8)) & 1;
+        if (right) {
+            way |= half;
+        }
+        node = 2 * node + 1 + right;
+    }
+    return way;
+}
+
+const replacement_policy_t policy_plru = {
+    .name = "plru",
+    .state_size = plru_state_size,
+    .init = plru_init,
+    .hit = plru_touch,
+    .victim = plru_victim,
+    .fill = plru_touch,
+    .fill_is_hit = 1,
+};
+
+// SRRIP keeps a 2-bit re-reference prediction value (RRPV) per way, four ways
+// per byte
+
+enum { RRPV_MAX = 3 };
+
+static uint32_t get_rrpv(const uint8_t *const state, const uint32_t way) {
+    return (state[way / 4] >> (2 * (way % 4))) & RRPV_MAX;
+}
+
+static void set_rrpv(uint8_t *const state, const uint32_t way,
+                     const uint32_t rrpv) {
+    const uint32_t shift = 2 * (way % 4);
+    const uint32_t mask = (uint32_t)RRPV_MAX << shift;
+    state[way / 4] = (uint8_t)((state[way / 4] & ~mask) | (rrpv << shift));
+}
+
+static size_t srrip_state_size(const uint32_t ways) { return (ways + 3) / 4; }
+
+static void srrip_init(uint8_t *const state, const uint32_t ways) {
+    for (uint32_t way = 0; way < ways; way++) {
+        set_rrpv(state, way, RRPV_MAX);
+    }
+}
+
+static void srrip_hit(uint8_t *const state, const uint32_t ways,
+                      const uint32_t way) {
+    (void)ways;
+    // Predict a near-immediate re-reference
+    set_rrpv(state, way, 0);
+}
+
+static uint32_t srrip_victim(uint8_t *const state, const uint32_t ways) {
+    while (1) {
+        for (uint32_t way = 0; way < ways; way++) {
+            if (get_rrpv(state, way) == RRPV_MAX) {
+                return way;
+            }
+        }
+        // Age every way until one is predicted to be re-referenced last
+        for (uint32_t way = 0; way < ways; way++) {
+            set_rrpv(state, way, get_rrpv(state, way) + 1);
+        }
+    }
+}
+
+static void srrip_fill(uint8_t *const state, const uint32_t ways,
+                       const uint32_t way) {
+    (void)ways;
+    // Predict a long re-reference interval for new lines
+    set_rrpv(state, way, RRPV_MAX - 1);
+}
+
+const replacement_policy_t policy_srrip = {
+    .name = "srrip",
+    .state_size = srrip_state_size,
+    .init = srrip_init,
+    .hit = srrip_hit,
+    .victim = srrip_victim,
+    .fill = srrip_fill,
+    .fill_is_hit = 0,
+};
+
+const replacement_policy_t *find_replacement_policy(const char *const name) {
+    const replacement_policy_t *const policies[] = {
+        &policy_fifo, &policy_lru, &policy_plru, &policy_srrip};
+
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        if (strcmp(policies[i]->name, name) == 0) {
+            return policies[i];
+        }
+    }
+    return NULL;
+}
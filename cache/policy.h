@@ -0,0 +1,42 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A replacement policy for the sets of a Set Associative cache. Each set has
+// `state_size(ways)` bytes of policy state, which starts out zeroed and is
+// then passed to `init`. Invalid ways are always filled before the policy is
+// asked for a victim.
+typedef struct replacement_policy {
+    // The command-line name of the policy
+    const char *name;
+    // Returns the number of bytes of state needed for a set with `ways` ways
+    size_t (*state_size)(uint32_t ways);
+    // Initializes the zeroed state of a set
+    void (*init)(uint8_t *state, uint32_t ways);
+    // Updates the state after a hit in `way`
+    void (*hit)(uint8_t *state, uint32_t ways, uint32_t way);
+    // Returns the way to evict when every way is valid
+    uint32_t (*victim)(uint8_t *state, uint32_t ways);
+    // Updates the state after a new line was inserted in `way`
+    void (*fill)(uint8_t *state, uint32_t ways, uint32_t way);
+    // Whether a hit right after a fill of the same way leaves the state as
+    // the fill set it
+    int fill_is_hit;
+} replacement_policy_t;
+
+// Evicts the ways in the order they were filled
+extern const replacement_policy_t policy_fifo;
+// Evicts the least recently used way
+extern const replacement_policy_t policy_lru;
+// Approximates LRU with a binary tree of ways - 1 bits. Needs a power of two
+// number of ways.
+extern const replacement_policy_t policy_plru;
+// Static re-reference interval prediction with 2-bit counters (Jaleel et al.)
+extern const replacement_policy_t policy_srrip;
+
+// Returns the policy named `name`, or NULL if there is none
+const replacement_policy_t *find_replacement_policy(const char *name);
+
+#endif
@@ -0,0 +1,156 @@
+#define _DEFAULT_SOURCE
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// The tasks left to a worker, packed as (begin << 32 | end) so the owner and
+// thieves can update both ends with a single compare-and-swap
+typedef struct {
+    _Atomic uint64_t range;
+    // Keep each worker's range on its own host cache line
+    char padding[64 - sizeof(uint64_t)];
+} pool_queue_t;
+
+typedef struct pool_t pool_t;
+
+// The state of one worker thread
+typedef struct {
+    pool_t *pool;
+    // The index of this worker's queue
+    unsigned index;
+} pool_worker_t;
+
+struct pool_t {
+    pool_queue_t *queues;
+    pool_worker_t *workers;
+    unsigned threads;
+    pool_task_fn run;
+    void *arg;
+};
+
+static uint64_t pack_range(const uint32_t begin, const uint32_t end) {
+    return (uint64_t)begin << 32 | end;
+}
+
+// Takes the first task of a queue. Returns 0 if the queue is empty.
+static int pop_task(pool_queue_t *const queue, uint32_t *const task) {
+    uint64_t range = atomic_load(&queue->range);
+    while (1) {
+        const uint32_t begin = (uint32_t)(range >> 32);
+        const uint32_t end = (uint32_t)range;
+        if (begin >= end) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak(&queue->range, &range,
+                                         pack_range(begin + 1, end))) {
+            *task = begin;
+            return 1;
+        }
+    }
+}
+
+// Moves the last half of the tasks of `victim` to the empty queue `thief`.
+// Returns 0 if there was nothing to steal.
+static int steal_tasks(pool_queue_t *const victim, pool_queue_t *const thief) {
+    uint64_t range = atomic_load(&victim->range);
+    while (1) {
+        const uint32_t begin = (uint32_t)(range >> 32);
+        const uint32_t end = (uint32_t)range;
+        if (begin >= end) {
+            return 0;
+        }
+        // Round up so a single remaining task can be stolen too
+        const uint32_t middle = end - (end - begin + 1) / 2;
+        if (atomic_compare_exchange_weak(&victim->range, &range,
+                                         pack_range(begin, middle))) {
+            // Only the owner adds to its own queue, and only when it is empty
+            atomic_store(&thief->range, pack_range(middle, end));
+            return 1;
+        }
+    }
+}
+
+static void *worker_main(void *const arg) {
+    const pool_worker_t *const worker = arg;
+    pool_t *const pool = worker->pool;
+    pool_queue_t *const own = &pool->queues[worker->index];
+
+    while (1) {
+        uint32_t task;
+        while (pop_task(own, &task)) {
+            pool->run(task, pool->arg);
+        }
+
+        // Look for work in the other queues, starting with the next worker
+        int stolen = 0;
+        for (unsigned i = 1; i < pool->threads && !stolen; i++) {
+            const unsigned victim = (worker->index + i) % pool->threads;
+            stolen = steal_tasks(&pool->queues[victim], own);
+        }
+        // Tasks never create new tasks, so when every queue is empty all
+        // remaining work is already running
+        if (!stolen) {
+            return NULL;
+        }
+    }
+}
+
+int pool_run(unsigned threads, const size_t tasks, const pool_task_fn run,
+             void *const arg) {
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > tasks) {
+        threads = tasks == 0 ? 1 : (unsigned)tasks;
+    }
+
+    pool_t pool = {.threads = threads, .run = run, .arg = arg};
+    pool.queues = calloc(threads, sizeof(pool_queue_t));
+    pool.workers = calloc(threads, sizeof(pool_worker_t));
+    pthread_t *const handles = calloc(threads, sizeof(pthread_t));
+    if (pool.queues == NULL || pool.workers == NULL || handles == NULL) {
+        free(pool.queues);
+        free(pool.workers);
+        free(handles);
+        return -1;
+    }
+
+    // Give every worker an equal share of the tasks
+    for (unsigned i = 0; i < threads; i++) {
+        const uint32_t begin = (uint32_t)(tasks * i / threads);
+        const uint32_t end = (uint32_t)(tasks * (i + 1) / threads);
+        atomic_init(&pool.queues[i].range, pack_range(begin, end));
+        pool.workers[i] = (pool_worker_t){.pool = &pool, .index = i};
+    }
+
+    // The calling thread is worker 0
+    int result = 0;
+    unsigned started = 1;
+    for (; started < threads; started++) {
+        if (pthread_create(&handles[started], NULL, worker_main,
+                           &pool.workers[started]) != 0) {
+            result = -1;
+            break;
+        }
+    }
+    worker_main(&pool.workers[0]);
+    for (unsigned i = 1; i < started; i++) {
+        pthread_join(handles[i], NULL);
+    }
+
+    free(pool.queues);
+    free(pool.workers);
+    free(handles);
+
+    return result;
+}
+
+unsigned pool_default_threads(void) {
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count < 1 ? 1 : (unsigned)count;
+}
@@ -0,0 +1,21 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Runs a task on a worker thread. `task` is the index of the task and `arg` is
+// the argument given to pool_run().
+typedef void (*pool_task_fn)(size_t task, void *arg);
+
+// Runs tasks 0 to `tasks - 1` on `threads` worker threads and returns when all
+// of them are done. The tasks are split evenly between the workers up front,
+// and a worker that runs out of tasks steals half of the remaining tasks of
+// another worker, so uneven task lengths still keep every worker busy.
+// Returns 0 on success, or -1 if the memory could not be allocated or the
+// threads could not be started.
+int pool_run(unsigned threads, size_t tasks, pool_task_fn run, void *arg);
+
+// Returns the number of online processors
+unsigned pool_default_threads(void);
+
+#endif
@@ -0,0 +1,367 @@
+#include "prefetch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Next-line prefetching has no state. Prefetching again on the first use of a
+// prefetched block keeps it ahead of a sequential stream.
+
+static size_t next_line_state_size(const uint32_t degree) {
+    (void)degree;
+    return 0;
+}
+
+static uint32_t next_line_access(uint8_t *const state, const uint32_t degree,
+                                 const uint64_t block,
+                                 const demand_outcome_t outcome,
+                                 const uint64_t now, uint64_t *const blocks) {
+    (void)state;
+    (void)now;
+    if (outcome == DEMAND_HIT) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < degree; i++) {
+        blocks[i] = block + i + 1;
+    }
+    return degree;
+}
+
+const prefetcher_t prefetcher_next_line = {
+    .name = "next",
+    .default_degree = 1,
+    .state_size = next_line_state_size,
+    .access = next_line_access,
+    .take = NULL,
+};
+
+// The stride prefetcher keeps a direct-mapped table of the regions accessed
+// recently, with the last block and stride seen in each
+
+// The number of entries in the region table
+enum { STRIDE_ENTRIES = 64 };
+// The number of address bits of a block number inside a region, so regions
+// are 64 blocks (4 KiB with 64-byte blocks)
+enum { STRIDE_REGION_BITS = 6 };
+// The largest confidence of a stride
+enum { STRIDE_MAX_CONFIDENCE = 3 };
+
+// A region in the stride table
+typedef struct {
+    // The region plus one, or zero if the entry is empty
+    uint64_t region;
+    // The last block accessed in the region
+    uint64_t last_block;
+    // The last stride between two blocks of the region, modulo 2^64
+    uint64_t stride;
+    // The number of times in a row the stride repeated
+    uint32_t confidence;
+} stride_entry_t;
+
+static size_t stride_state_size(const uint32_t degree) {
+    (void)degree;
+    return STRIDE_ENTRIES * sizeof(stride_entry_t);
+}
+
+static uint32_t stride_access(uint8_t *const state, const uint32_t degree,
+                              const uint64_t block,
+                              const demand_outcome_t outcome,
+                              const uint64_t now, uint64_t *const blocks) {
+    (void)outcome;
+    (void)now;
+    const uint64_t region = block >> STRIDE_REGION_BITS;
+    stride_entry_t *const entry =
+        (stride_entry_t *)state +
+        ((region * 0x9e3779b97f4a7c15ULL) >> 32) % STRIDE_ENTRIES;
+
+    if (entry->region != region + 1) {
+        // Start tracking the region, evicting whichever one was there
+        entry->region = region + 1;
+        entry->last_block = block;
+        entry->stride = 0;
+        entry->confidence = 0;
+        return 0;
+    }
+
+    // Accesses to the same block say nothing about the stride
+    const uint64_t stride = block - entry->last_block;
+    if (stride == 0) {
+        return 0;
+    }
+    if (stride == entry->stride) {
+        if (entry->confidence < STRIDE_MAX_CONFIDENCE) {
+            entry->confidence++;
+        }
+    } else {
+        entry->stride = stride;
+        entry->confidence = 0;
+    }
+    entry->last_block = block;
+
+    // Only prefetch once the stride has repeated
+    if (entry->confidence == 0) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < degree; i++) {
+        blocks[i] = block + (i + 1) * stride;
+    }
+    return degree;
+}
+
+const prefetcher_t prefetcher_stride = {
+    .name = "stride",
+    .default_degree = 2,
+    .state_size = stride_state_size,
+    .access = stride_access,
+    .take = NULL,
+};
+
+// The stream prefetcher keeps STREAM_BUFFERS FIFO buffers of up to `degree`
+// sequential blocks. A miss that no buffer holds restarts the least recently
+// used buffer after the missing block. Every entry of a buffer is searched, so
+// a stream that skips a block does not lose its buffer.
+
+// The number of stream buffers
+enum { STREAM_BUFFERS = 4 };
+
+// A stream buffer
+typedef struct {
+    // The blocks in the buffer, oldest first, and when each was prefetched
+    uint64_t blocks[PREFETCH_MAX_DEGREE];
+    uint64_t issued_at[PREFETCH_MAX_DEGREE];
+    // The number of blocks in the buffer
+    uint32_t count;
+    // The block the buffer prefetches next
+    uint64_t next;
+    // The time the buffer was last started or taken from, or zero if it was
+    // never started
+    uint64_t last_used;
+} stream_buffer_t;
+
+static size_t stream_state_size(const uint32_t degree) {
+    (void)degree;
+    return STREAM_BUFFERS * sizeof(stream_buffer_t);
+}
+
+static uint32_t stream_access(uint8_t *const state, const uint32_t degree,
+                              const uint64_t block,
+                              const demand_outcome_t outcome,
+                              const uint64_t now, uint64_t *const blocks) {
+    stream_buffer_t *const buffers = (stream_buffer_t *)state;
+
+    if (outcome == DEMAND_MISS) {
+        stream_buffer_t *lru = &buffers[0];
+        for (uint32_t b = 1; b < STREAM_BUFFERS; b++) {
+            if (buffers[b].last_used < lru->last_used) {
+                lru = &buffers[b];
+            }
+        }
+        lru->count = 0;
+        lru->next = block + 1;
+        lru->last_used = now;
+    }
+
+    // Top up the buffers that were started or taken from. At most one buffer
+    // changes per access, so this never asks for more than `degree` blocks.
+    uint32_t count = 0;
+    for (uint32_t b = 0; b < STREAM_BUFFERS; b++) {
+        stream_buffer_t *const buffer = &buffers[b];
+        while (buffer->last_used != 0 && buffer->count < degree &&
+               count < degree) {
+            buffer->blocks[buffer->count] = buffer->next;
+            buffer->issued_at[buffer->count] = now;
+            buffer->count++;
+            blocks[count++] = buffer->next++;
+        }
+    }
+    return count;
+}
+
+static int stream_take(uint8_t *const state, const uint32_t degree,
+                       const uint64_t block, const uint64_t now,
+                       uint64_t *const issued_at) {
+    (void)degree;
+    stream_buffer_t *const buffers = (stream_buffer_t *)state;
+
+    for (uint32_t b = 0; b < STREAM_BUFFERS; b++) {
+        stream_buffer_t *const buffer = &buffers[b];
+        for (uint32_t i = 0; i < buffer->count; i++) {
+            if (buffer->blocks[i] != block) {
+                continue;
+            }
+            // The blocks before the one taken were skipped by the stream, so
+            // they are dropped with it
+            *issued_at = buffer->issued_at[i];
+            const uint32_t kept = buffer->count - i - 1;
+            memmove(buffer->blocks, buffer->blocks + i + 1,
+                    kept * sizeof(uint64_t));
+            memmove(buffer->issued_at, buffer->issued_at + i + 1,
+                    kept * sizeof(uint64_t));
+            buffer->count = kept;
+            buffer->last_used = now;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const prefetcher_t prefetcher_stream = {
+    .name = "stream",
+    .default_degree = 4,
+    .state_size = stream_state_size,
+    .access = stream_access,
+    .take = stream_take,
+};
+
+const prefetcher_t *find_prefetcher(const char *const name) {
+    const prefetcher_t *const prefetchers[] = {
+        &prefetcher_next_line, &prefetcher_stride, &prefetcher_stream};
+
+    for (size_t i = 0; i < sizeof(prefetchers) / sizeof(prefetchers[0]);
+         i++) {
+        if (strcmp(prefetchers[i]->name, name) == 0) {
+            return prefetchers[i];
+        }
+    }
+    return NULL;
+}
+
+int parse_prefetcher(const char *const str,
+                     const prefetcher_t **const prefetcher,
+                     uint32_t *const degree) {
+    char name[16];
+    const char *const colon = strchr(str, ':');
+    const size_t length = colon == NULL ? strlen(str) : (size_t)(colon - str);
+    if (length >= sizeof(name)) {
+        return -1;
+    }
+    memcpy(name, str, length);
+    name[length] = '\0';
+
+    *prefetcher = find_prefetcher(name);
+    if (*prefetcher == NULL) {
+        return -1;
+    }
+    if (colon == NULL) {
+        *degree = (*prefetcher)->default_degree;
+        return 0;
+    }
+
+    char *end;
+    const unsigned long value = strtoul(colon + 1, &end, 10);
+    if (end == colon + 1 || *end != '\0' || value == 0 ||
+        value > PREFETCH_MAX_DEGREE) {
+        return -1;
+    }
+    *degree = (uint32_t)value;
+    return 0;
+}
+
+int prefetch_unit_init(prefetch_unit_t *const unit,
+                       const prefetcher_t *const prefetcher,
+                       const uint32_t degree, const uint32_t latency,
+                       const uint32_t lines) {
+    const size_t state_size = prefetcher->state_size(degree);
+
+    unit->prefetcher = prefetcher;
+    unit->degree = degree;
+    unit->latency = latency;
+    unit->state = state_size == 0 ? NULL : calloc(1, state_size);
+    unit->clock = 0;
+    unit->prefetched_at = calloc(lines, sizeof(uint64_t));
+
+    // The filter has at least as many entries as the cache has lines
+    unit->filter_bits = 1;
+    while ((1U << unit->filter_bits) < lines) {
+        unit->filter_bits++;
+    }
+    unit->filter = calloc((size_t)1 << unit->filter_bits, sizeof(uint64_t));
+
+    unit->issued = 0;
+    unit->useful = 0;
+    unit->late = 0;
+    unit->polluting = 0;
+    unit->writebacks = 0;
+
+    if ((state_size != 0 && unit->state == NULL) ||
+        unit->prefetched_at == NULL || unit->filter == NULL) {
+        prefetch_unit_free(unit);
+        return -1;
+    }
+    return 0;
+}
+
+void prefetch_unit_free(prefetch_unit_t *const unit) {
+    free(unit->state);
+    free(unit->prefetched_at);
+    free(unit->filter);
+}
+
+size_t prefetch_state_bytes(const prefetch_unit_t *const unit) {
+    return unit->prefetcher->state_size(unit->degree);
+}
+
+size_t prefetch_filter_entries(const prefetch_unit_t *const unit) {
+    return (size_t)1 << unit->filter_bits;
+}
+
+// Returns the pollution filter entry of `block`
+static uint64_t *filter_entry(const prefetch_unit_t *const unit,
+                              const uint64_t block) {
+    return &unit->filter[(block * 0x9e3779b97f4a7c15ULL) >>
+                         (64 - unit->filter_bits)];
+}
+
+// Counts the use of a block that was prefetched at `issued_at`
+static void count_use(prefetch_unit_t *const unit, const uint64_t issued_at) {
+    unit->useful++;
+    if (unit->clock - issued_at < unit->latency) {
+        unit->late++;
+    }
+}
+
+demand_outcome_t prefetch_hit(prefetch_unit_t *const unit,
+                              const uintptr_t line) {
+    unit->clock++;
+    const uint64_t issued_at = unit->prefetched_at[line];
+    if (issued_at == 0) {
+        return DEMAND_HIT;
+    }
+    unit->prefetched_at[line] = 0;
+    count_use(unit, issued_at);
+    return DEMAND_PREFETCHED;
+}
+
+int prefetch_miss(prefetch_unit_t *const unit, const uint64_t block,
+                  const int take) {
+    unit->clock++;
+    uint64_t *const entry = filter_entry(unit, block);
+    if (*entry == block + 1) {
+        unit->polluting++;
+        *entry = 0;
+    }
+
+    uint64_t issued_at;
+    if (!take || unit->prefetcher->take == NULL ||
+        !unit->prefetcher->take(unit->state, unit->degree, block, unit->clock,
+                                &issued_at)) {
+        return 0;
+    }
+    count_use(unit, issued_at);
+    return 1;
+}
+
+void prefetch_filled(prefetch_unit_t *const unit, const uintptr_t line,
+                     const uint64_t block, const int evicted,
+                     const uint64_t victim) {
+    unit->prefetched_at[line] = unit->clock;
+    unit->issued++;
+
+    // A block that is cached again cannot miss because of an older prefetch
+    uint64_t *const entry = filter_entry(unit, block);
+    if (*entry == block + 1) {
+        *entry = 0;
+    }
+    if (evicted) {
+        *filter_entry(unit, victim) = victim + 1;
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "simtypes.h"
+
+// The largest number of blocks a prefetcher fetches ahead
+enum { PREFETCH_MAX_DEGREE = 16 };
+// The default number of demand accesses to a cache between issuing a
+// prefetch and its block arriving
+enum { PREFETCH_DEFAULT_LATENCY = 16 };
+
+// How a demand access was served, as seen by a prefetcher
+typedef enum {
+    // The block was fetched from the next level
+    DEMAND_MISS,
+    // The block was cached
+    DEMAND_HIT,
+    // This is the first use of a block that was brought in by a prefetch
+    DEMAND_PREFETCHED
+} demand_outcome_t;
+
+// A hardware prefetcher. It observes the block of every demand access to a
+// cache and asks for the blocks it expects to be accessed next. Each
+// prefetcher has `state_size(degree)` bytes of state, which starts out zeroed,
+// where `degree` is how far ahead it fetches.
+//
+// Most prefetchers fill the cache with the blocks they fetch. A buffered
+// prefetcher holds them in buffers of its own instead, and a demand miss
+// takes its block from them, so prefetches never evict a cached line.
+typedef struct prefetcher {
+    // The command-line name of the prefetcher
+    const char *name;
+    // The degree when none is given
+    uint32_t default_degree;
+    // Returns the number of bytes of state for a prefetcher of `degree`
+    size_t (*state_size)(uint32_t degree);
+    // Observes a demand access to `block` at time `now` and writes the blocks
+    // to prefetch to `blocks`. Returns their number, at most `degree`.
+    uint32_t (*access)(uint8_t *state, uint32_t degree, uint64_t block,
+                       demand_outcome_t outcome, uint64_t now,
+                       uint64_t *blocks);
+    // Removes `block` from the buffers of a buffered prefetcher at time `now`.
+    // Returns 1 and sets `issued_at` to the time it was prefetched if it was
+    // held, otherwise 0. NULL if the prefetcher fills the cache.
+    int (*take)(uint8_t *state, uint32_t degree, uint64_t block, uint64_t now,
+                uint64_t *issued_at);
+} prefetcher_t;
+
+// Fetches the blocks after a block that missed or was prefetched (tagged
+// next-line prefetching)
+extern const prefetcher_t prefetcher_next_line;
+// Detects constant strides between the blocks accessed in each region of 64
+// blocks (4 KiB with the default block size), since traces have no program
+// counters, and fetches along them
+extern const prefetcher_t prefetcher_stride;
+// Starts a stream buffer of `degree` sequential blocks at every miss that no
+// buffer holds, and refills a buffer as its blocks are taken (Jouppi)
+extern const prefetcher_t prefetcher_stream;
+
+// Returns the prefetcher named `name`, or NULL if there is none
+const prefetcher_t *find_prefetcher(const char *name);
+
+// The prefetch stage of one cache. It runs the prefetcher, remembers which
+// lines hold prefetched blocks that were not used yet, and keeps a pollution
+// filter of the blocks that prefetches evicted, so a demand miss on one of
+// them is blamed on the prefetch.
+//
+// Times are counted in demand accesses to the cache. A prefetch is late if
+// its block is used less than `latency` accesses after it was issued, when it
+// would still have been on its way from the next level.
+typedef struct {
+    // The prefetcher and how far ahead it fetches
+    const prefetcher_t *prefetcher;
+    uint32_t degree;
+    // The number of demand accesses a prefetch takes to arrive
+    uint32_t latency;
+    // The state of the prefetcher, or NULL if it has none
+    uint8_t *state;
+    // The number of demand accesses so far
+    uint64_t clock;
+    // The time the block of each cache line was prefetched, or zero if it was
+    // fetched on demand or was already used
+    uint64_t *prefetched_at;
+    // Direct-mapped filter of the blocks (plus one) that prefetches evicted,
+    // with 2^filter_bits entries
+    uint64_t *filter;
+    uint32_t filter_bits;
+
+    // The counts since they were last added to the statistics
+    uint64_t issued;
+    uint64_t useful;
+    uint64_t late;
+    uint64_t polluting;
+    // The dirty lines that prefetches evicted
+    uint64_t writebacks;
+} prefetch_unit_t;
+
+// Initializes the prefetch stage of a cache with `lines` lines. Returns 0 on
+// success, or -1 if its memory cannot be allocated.
+int prefetch_unit_init(prefetch_unit_t *unit, const prefetcher_t *prefetcher,
+                       uint32_t degree, uint32_t latency, uint32_t lines);
+
+// Frees the memory of a prefetch stage
+void prefetch_unit_free(prefetch_unit_t *unit);
+
+// Returns the number of bytes of prefetcher state of a prefetch stage
+size_t prefetch_state_bytes(const prefetch_unit_t *unit);
+
+// Returns the number of entries in the pollution filter of a prefetch stage
+size_t prefetch_filter_entries(const prefetch_unit_t *unit);
+
+// Every demand access to the cache is recorded with one of the two functions
+// below, before the prefetcher observes it.
+
+// Records a demand hit on cache line `line`. Returns DEMAND_PREFETCHED and
+// counts a useful prefetch if the line was prefetched and not used yet,
+// otherwise DEMAND_HIT.
+demand_outcome_t prefetch_hit(prefetch_unit_t *unit, uintptr_t line);
+
+// Records a demand miss on `block`, counting a polluting prefetch if a
+// prefetch evicted it. Returns 1 and counts a useful prefetch if a buffered
+// prefetcher held the block and `take` is set, otherwise 0.
+int prefetch_miss(prefetch_unit_t *unit, uint64_t block, int take);
+
+// Records that a prefetch filled cache line `line` with `block`, evicting
+// `victim` if `evicted` is set
+void prefetch_filled(prefetch_unit_t *unit, uintptr_t line, uint64_t block,
+                     int evicted, uint64_t victim);
+
+#endif
@@ -0,0 +1,89 @@
+#include "prefilter.h"
+
+#include <string.h>
+
+void prefilter_init(prefilter_t *const filter,
+                    const cache_context_t *const ctx) {
+    memset(filter->runs, 0, sizeof(filter->runs));
+    filter->organization = ctx->organization;
+    filter->offset_bits = ctx->offset_bits;
+    filter->write_back = ctx->write_policy == WRITE_BACK;
+    filter->write_allocate = ctx->write_miss == WRITE_ALLOCATE;
+    // Only Set Associative caches have replacement state
+    const replacement_policy_t *const policy = ctx->instr_cache->policy;
+    filter->fill_is_hit = policy == NULL || policy->fill_is_hit;
+}
+
+size_t prefilter_batch(prefilter_t *const filter,
+                       const mem_access_t *const accesses, const size_t count,
+                       mem_access_t *const out, cache_stat_t *const stat) {
+    // Both access types share run[0] when the cache is unified
+    const uint32_t type_mask = filter->organization == SPLIT ? 1 : 0;
+    const uint32_t offset_bits = filter->offset_bits;
+    const uint32_t write_back = filter->write_back;
+    const uint32_t write_allocate = filter->write_allocate;
+    const uint32_t fill_is_hit = filter->fill_is_hit;
+    // The collapsed accesses of each access type
+    uint64_t collapsed[2] = {0, 0};
+    uint64_t writes = 0;
+    size_t kept = 0;
+
+    // Runs are short and irregular, so the loop has no branches on them. Every
+    // access is copied, and only the ones that are kept advance `kept`.
+    for (size_t i = 0; i < count; i++) {
+        const mem_access_t access = accesses[i];
+        access_run_t *const run = &filter->runs[access.accessType & type_mask];
+        const uint64_t block = access.address >> offset_bits;
+        const uint32_t is_write = access.isWrite;
+
+        // Nothing is known about a block that starts a new run
+        const uint32_t same = block == run->block;
+        const uint32_t cached = run->cached & same;
+        const uint32_t dirty = run->dirty & same;
+        const uint32_t collapse = run->hit & same & ((is_write ^ 1) | dirty);
+
+        // Follow what the cache does with the access. A collapsed access
+        // leaves the run as it is.
+        run->block = block;
+        run->cached = cached | (is_write ^ 1) | write_allocate;
+        run->hit = cached | (run->cached & fill_is_hit);
+        run->dirty = dirty | (is_write & write_back & run->cached);
+
+        out[kept] = access;
+        kept += !collapse;
+        collapsed[access.accessType] += collapse;
+        writes += collapse & is_write;
+    }
+
+    stat->accesses += collapsed[INSTRUCTION] + collapsed[DATA];
+    stat->hits += collapsed[INSTRUCTION] + collapsed[DATA];
+    stat->instr_accesses += collapsed[INSTRUCTION];
+    stat->instr_hits += collapsed[INSTRUCTION];
+    stat->data_accesses += collapsed[DATA];
+    stat->data_hits += collapsed[DATA];
+    stat->writes += writes;
+    return kept;
+}
+
+void prefilter_read_batch(prefilter_t *const filter,
+                          const cache_kernel_fn read_batch,
+                          const cache_context_t *const ctx,
+                          const mem_access_t *const accesses,
+                          const size_t count, cache_stat_t *const stat) {
+    for (size_t start = 0; start < count; start += PREFILTER_CHUNK_SIZE) {
+        const size_t n = count - start < PREFILTER_CHUNK_SIZE
+                             ? count - start
+                             : PREFILTER_CHUNK_SIZE;
+        const size_t kept =
+            prefilter_batch(filter, accesses + start, n, filter->kept, stat);
+        read_batch(ctx, filter->kept, kept, stat);
+    }
+}
+
+const char *prefilter_config_error(const cache_config_t *const config) {
+    if (config->prefetcher != NULL) {
+        return "A prefetcher observes every access, so a cache with one "
+               "cannot be pre-filtered";
+    }
+    return NULL;
+}
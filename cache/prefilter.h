@@ -0,0 +1,75 @@
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cache.h"
+#include "trace.h"
+
+// The number of accesses the pre-filter passes to a kernel at a time
+enum { PREFILTER_CHUNK_SIZE = 2048 };
+
+// The run of accesses to one block in a stream of accesses that reach the same
+// cache
+typedef struct {
+    // The block of the run
+    uint64_t block;
+    // Whether the block is known to be cached
+    uint32_t cached;
+    // Whether the replacement state of the block is that of a hit, so another
+    // hit leaves it as it is
+    uint32_t hit;
+    // Whether the block is known to be dirty in a write-back cache
+    uint32_t dirty;
+} access_run_t;
+
+// Collapses runs of accesses to the same block before they reach a cache.
+//
+// Once an access to a block hit, another access to it in the same cache with
+// nothing else in between is a hit that changes nothing: every replacement
+// policy and the miss classifier already moved the block where a hit moves
+// it. Unless the policy puts a filled block somewhere else than a hit does,
+// the same is true right after a miss. Such accesses are counted as hits
+// without being simulated, so the statistics are exactly those of the full
+// trace. Writes are only collapsed into a write-back cache that already holds
+// the block dirty, and caches with a prefetcher are never filtered because it
+// observes every access.
+typedef struct {
+    // The run of the accesses of each type, or of all of them in runs[0] when
+    // the cache is unified
+    access_run_t runs[2];
+    cache_org_t organization;
+    uint32_t offset_bits;
+    // Whether a write marks a cached block dirty
+    uint32_t write_back;
+    // Whether a write that misses brings the block in
+    uint32_t write_allocate;
+    // Whether a filled block has the replacement state of a hit
+    uint32_t fill_is_hit;
+    // The accesses that are passed on to the kernel
+    mem_access_t kept[PREFILTER_CHUNK_SIZE];
+} prefilter_t;
+
+// Starts a pre-filter in front of the caches of `ctx`. From then on, every
+// access to them must go through the pre-filter.
+void prefilter_init(prefilter_t *filter, const cache_context_t *ctx);
+
+// Copies the accesses of a batch that must be simulated to `out`, which may be
+// `accesses` itself, and counts the others in `stat`. Returns the number of
+// accesses copied.
+size_t prefilter_batch(prefilter_t *filter, const mem_access_t *accesses,
+                       size_t count, mem_access_t *out, cache_stat_t *stat);
+
+// Simulates a batch with `read_batch` on the caches of `ctx` with the
+// collapsed accesses filtered out
+void prefilter_read_batch(prefilter_t *filter, cache_kernel_fn read_batch,
+                          const cache_context_t *ctx,
+                          const mem_access_t *accesses, size_t count,
+                          cache_stat_t *stat);
+
+// Returns a description of why a valid configuration cannot be pre-filtered,
+// or NULL if it can
+const char *prefilter_config_error(const cache_config_t *config);
+
+#endif
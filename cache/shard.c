@@ -0,0 +1,164 @@
+#include "shard.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+// The state shared by the phases of a sharded simulation
+typedef struct {
+    cache_context_t ctx;
+    // The simulation kernel for the context
+    cache_kernel_fn read_batch;
+    // The accesses in trace order
+    const mem_access_t *accesses;
+    size_t count;
+    // The accesses ordered by shard, in trace order within each shard
+    mem_access_t *partitioned;
+
+    // The number of shards and the number of trace chunks partitioned in
+    // parallel
+    size_t shards;
+    size_t chunks;
+    // The number of sets in each shard
+    uint32_t sets_per_shard;
+
+    // The number of accesses of each chunk in each shard, and after the
+    // prefix sum where each chunk writes the accesses of each shard
+    size_t *offsets;
+    // Where each shard starts and ends in `partitioned`
+    size_t *shard_begin;
+    size_t *shard_end;
+    // The statistics of each shard
+    cache_stat_t *stats;
+} shard_job_t;
+
+// Returns the shard of an access
+static size_t shard_of(const shard_job_t *const job,
+                       const mem_access_t access) {
+    const uint32_t set = (uint32_t)extract_bits(
+        access.address, job->ctx.offset_bits, job->ctx.index_bits);
+    return set / job->sets_per_shard;
+}
+
+// Returns the first access of chunk `chunk`
+static size_t chunk_begin(const shard_job_t *const job, const size_t chunk) {
+    return job->count * chunk / job->chunks;
+}
+
+// Counts the accesses of a chunk that belong to each shard
+static void count_task(const size_t chunk, void *const arg) {
+    shard_job_t *const job = arg;
+    size_t *const counts = job->offsets + chunk * job->shards;
+    for (size_t i = chunk_begin(job, chunk); i < chunk_begin(job, chunk + 1);
+         i++) {
+        counts[shard_of(job, job->accesses[i])]++;
+    }
+}
+
+// Copies the accesses of a chunk to their shards
+static void scatter_task(const size_t chunk, void *const arg) {
+    shard_job_t *const job = arg;
+    size_t *const offsets = job->offsets + chunk * job->shards;
+    for (size_t i = chunk_begin(job, chunk); i < chunk_begin(job, chunk + 1);
+         i++) {
+        const mem_access_t access = job->accesses[i];
+        job->partitioned[offsets[shard_of(job, access)]++] = access;
+    }
+}
+
+// Simulates the accesses of a shard. Only this shard's sets are touched.
+static void simulate_task(const size_t shard, void *const arg) {
+    shard_job_t *const job = arg;
+    memset(&job->stats[shard], 0, sizeof(cache_stat_t));
+    job->read_batch(&job->ctx, job->partitioned + job->shard_begin[shard],
+                    job->shard_end[shard] - job->shard_begin[shard],
+                    &job->stats[shard]);
+}
+
+// Returns the greatest common divisor of `a` and `b`
+static uint32_t gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        const uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+static void free_job(shard_job_t *const job) {
+    free(job->partitioned);
+    free(job->offsets);
+    free(job->shard_begin);
+    free(job->shard_end);
+    free(job->stats);
+}
+
+int simulate_sharded(const cache_context_t ctx,
+                     const mem_access_t *const accesses, const size_t count,
+                     const unsigned threads, cache_stat_t *const stat) {
+    const uint32_t sets = 1U << ctx.index_bits;
+    const uint32_t ways =
+        ctx.mapping == SET_ASSOCIATIVE ? ctx.instr_cache->ways : 1;
+
+    // Neighbouring shards must not share a word of the valid bitmap, so
+    // each shard starts at a multiple of 64 lines
+    const uint32_t granularity = 64 / gcd(ways, 64);
+    uint32_t sets_per_shard = (sets + threads - 1) / threads;
+    sets_per_shard =
+        (sets_per_shard + granularity - 1) / granularity * granularity;
+
+    shard_job_t job = {.ctx = ctx,
+                       .read_batch = cache_select_kernel(&ctx),
+                       .accesses = accesses,
+                       .count = count,
+                       .sets_per_shard = sets_per_shard,
+                       .shards = (sets + sets_per_shard - 1) / sets_per_shard,
+                       .chunks = threads};
+    if (count == 0) {
+        return 0;
+    }
+    job.partitioned = malloc(count * sizeof(mem_access_t));
+    job.offsets = calloc(job.chunks * job.shards, sizeof(size_t));
+    job.shard_begin = malloc(job.shards * sizeof(size_t));
+    job.shard_end = malloc(job.shards * sizeof(size_t));
+    job.stats = malloc(job.shards * sizeof(cache_stat_t));
+    if (job.partitioned == NULL || job.offsets == NULL ||
+        job.shard_begin == NULL || job.shard_end == NULL || job.stats == NULL) {
+        free_job(&job);
+        return -1;
+    }
+
+    int result = pool_run(threads, job.chunks, count_task, &job);
+
+    // Turn the counts into the offset where each chunk writes each shard,
+    // with the shards in order and the chunks in trace order within them
+    size_t offset = 0;
+    for (size_t s = 0; s < job.shards; s++) {
+        job.shard_begin[s] = offset;
+        for (size_t c = 0; c < job.chunks; c++) {
+            const size_t chunk_count = job.offsets[c * job.shards + s];
+            job.offsets[c * job.shards + s] = offset;
+            offset += chunk_count;
+        }
+        job.shard_end[s] = offset;
+    }
+
+    if (result == 0) {
+        result = pool_run(threads, job.chunks, scatter_task, &job);
+    }
+    if (result == 0) {
+        result = pool_run(threads, job.shards, simulate_task, &job);
+    }
+
+    if (result == 0) {
+        for (size_t s = 0; s < job.shards; s++) {
+            cache_stat_add(stat, &job.stats[s]);
+        }
+    }
+
+    free_job(&job);
+
+    return result;
+}
@@ -0,0 +1,19 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+
+#include "cache.h"
+#include "trace.h"
+
+// Simulates `accesses` on a Direct Mapped or Set Associative context by
+// splitting the sets into one shard per thread. The accesses are first
+// partitioned by the shard of their set, keeping their order, and each shard
+// is then simulated on its own thread. Since sets never interact, the merged
+// statistics are exactly those of a serial simulation. Returns 0 on success,
+// or -1 if the memory could not be allocated or the threads could not be
+// started.
+int simulate_sharded(cache_context_t ctx, const mem_access_t *accesses,
+                     size_t count, unsigned threads, cache_stat_t *stat);
+
+#endif
@@ -0,0 +1,117 @@
+#define _DEFAULT_SOURCE
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cache.h"
+#include "workload.h"
+
+enum { BATCH_SIZE = 16384 };
+
+// The default number of accesses of each workload
+#define DEFAULT_ACCESSES 10000000UL
+
+// The cache simulated with every mapping and organization
+enum { BENCH_CACHE_SIZE = 32768 };
+
+// Returns the current time in seconds from a monotonic clock
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Simulates a workload on a cache and prints the throughput. Only the
+// simulation is timed, not generating the accesses.
+static void bench(const workload_config_t *const workload_config,
+                  const cache_config_t *const cache_config) {
+    static mem_access_t batch[BATCH_SIZE];
+
+    cache_context_t ctx;
+    if (create_context(cache_config, &ctx) < 0) {
+        printf("Unable to allocate the caches\n");
+        exit(1);
+    }
+    const cache_kernel_fn read_batch = cache_select_kernel(&ctx);
+    cache_stat_t stat;
+    memset(&stat, 0, sizeof(cache_stat_t));
+
+    workload_t workload;
+    workload_init(&workload, workload_config);
+
+    double seconds = 0.0;
+    size_t count;
+    while ((count = workload_generate(&workload, batch, BATCH_SIZE)) > 0) {
+        const double start = now();
+        read_batch(&ctx, batch, count, &stat);
+        seconds += now() - start;
+    }
+
+    destroy_context(ctx);
+
+    char mapping[16];
+    format_cache_mapping(cache_config, mapping, sizeof(mapping));
+    printf("%-10s %7s %12s %14.0f %10.2f %8.4f\n",
+           workload_kind_name(workload_config->kind), mapping,
+           cache_org_name(cache_config->organization),
+           (double)stat.accesses / seconds,
+           seconds * 1e9 / (double)stat.accesses,
+           (double)stat.hits / (double)stat.accesses);
+}
+
+// Measures the simulation throughput of every synthetic workload with every
+// cache mapping and organization
+int main(const int argc, const char **argv) {
+    if (argc > 2) {
+        printf("usage: simbench [number of accesses per workload]\n");
+        exit(1);
+    }
+
+    workload_config_t workload_config;
+    workload_defaults(&workload_config);
+    if (argc == 2) {
+        workload_config.length = strtoull(argv[1], NULL, 10);
+    }
+    if (workload_config.length == 0) {
+        printf("The number of accesses must be positive\n");
+        exit(1);
+    }
+
+    const workload_kind_t kinds[] = {WORKLOAD_SEQUENTIAL, WORKLOAD_STRIDED,
+                                     WORKLOAD_RANDOM, WORKLOAD_ZIPF,
+                                     WORKLOAD_LOOP};
+    const cache_map_t mappings[] = {DIRECT_MAPPING, SET_ASSOCIATIVE,
+                                    FULLY_ASSOCIATIVE};
+    const cache_org_t orgs[] = {UNIFIED, SPLIT};
+
+    printf("Simulating %" PRIu64 " accesses per workload on %d byte caches\n\n",
+           workload_config.length, BENCH_CACHE_SIZE);
+    printf("%-10s %7s %12s %14s %10s %8s\n", "Workload", "Mapping",
+           "Organization", "Accesses/sec", "ns/access", "Hit Rate");
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        workload_config.kind = kinds[k];
+        for (size_t m = 0; m < sizeof(mappings) / sizeof(mappings[0]); m++) {
+            for (size_t o = 0; o < sizeof(orgs) / sizeof(orgs[0]); o++) {
+                cache_config_t cache_config = {.size = BENCH_CACHE_SIZE,
+                                               .mapping = mappings[m],
+                                               .organization = orgs[o],
+                                               .ways = 0,
+                                               .block_size = DEFAULT_BLOCK_SIZE,
+                                               .address_bits =
+                                                   DEFAULT_ADDRESS_BITS,
+                                               .policy = NULL};
+                if (mappings[m] == SET_ASSOCIATIVE) {
+                    cache_config.ways = 4;
+                }
+                parse_cache_policy(NULL, &cache_config);
+                bench(&workload_config, &cache_config);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+#ifndef SIMTYPES_H
+#define SIMTYPES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The types and configuration helpers of the simulator library's API
+// (cachesim.h). The caches themselves are private to the library.
+
+// The replacement policies (policy.h) and prefetchers (prefetch.h) are only
+// referred to by pointer
+typedef struct replacement_policy replacement_policy_t;
+typedef struct prefetcher prefetcher_t;
+
+typedef enum { INSTRUCTION, DATA } access_t;
+
+// The widest addresses a trace can hold
+enum { MAX_ADDRESS_BITS = 64 };
+
+typedef struct {
+    uint64_t address;
+    // INSTRUCTION or DATA, in a byte so an access fits in 16 bytes
+    uint8_t accessType;
+    // Whether the access is a store. Only data accesses can be stores.
+    uint8_t isWrite;
+} mem_access_t;
+
+// A position in a trace that reading can resume from
+typedef struct {
+    // The byte offset of the next line, or of the binary block that holds the
+    // next access
+    uint64_t offset;
+    // The number of accesses of the binary block at `offset` that were already
+    // read
+    uint32_t skip;
+} trace_position_t;
+
+// The block size in bytes when none is given
+enum { DEFAULT_BLOCK_SIZE = 64 };
+// The number of address bits when none is given. Tags that fit in 32 bits are
+// stored in half the memory, so the default keeps them there.
+enum { DEFAULT_ADDRESS_BITS = 32 };
+
+typedef enum {
+    DIRECT_MAPPING,
+    FULLY_ASSOCIATIVE,
+    SET_ASSOCIATIVE
+} cache_map_t;
+typedef enum { UNIFIED, SPLIT } cache_org_t;
+// When stores reach the next level
+typedef enum {
+    // Stores only mark their line dirty, and dirty lines are written back
+    // when they are evicted
+    WRITE_BACK,
+    // Every store is also written to the next level
+    WRITE_THROUGH
+} write_policy_t;
+// What a store that misses does
+typedef enum {
+    // The block is fetched into the cache, then written
+    WRITE_ALLOCATE,
+    // The store goes to the next level without filling a line
+    NO_WRITE_ALLOCATE
+} write_miss_t;
+// The bytes written by a store. Traces have no access sizes, so every store
+// writes one 32-bit word.
+enum { STORE_SIZE = 4 };
+typedef struct {
+    uint64_t accesses;
+    uint64_t hits;
+    // You can declare additional statistics if
+    // you like, however you are now allowed to
+    // remove the accesses or hits
+    uint64_t instr_accesses;
+    uint64_t instr_hits;
+    uint64_t data_accesses;
+    uint64_t data_hits;
+    // The misses of each kind, when misses are classified
+    uint64_t compulsory_misses;
+    uint64_t capacity_misses;
+    uint64_t conflict_misses;
+    // The data accesses that were stores
+    uint64_t writes;
+    // The dirty lines written back to the next level when they were evicted
+    uint64_t writebacks;
+    // The bytes fetched from and written to the next level
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    // The prefetches sent to the next level
+    uint64_t prefetches_issued;
+    // The prefetched blocks that were used by a demand access
+    uint64_t prefetches_useful;
+    // The useful prefetches that were used before they could have arrived
+    uint64_t prefetches_late;
+    // The demand misses on blocks that a prefetch evicted
+    uint64_t prefetches_polluting;
+} cache_stat_t;
+
+// A cache configuration to simulate
+typedef struct {
+    // The total cache size in bytes
+    uint32_t size;
+    // The cache mapping
+    cache_map_t mapping;
+    // The cache organization
+    cache_org_t organization;
+    // The number of ways in each set when the mapping is Set Associative
+    uint32_t ways;
+    // The size of a block in bytes, a power of two
+    uint32_t block_size;
+    // The number of address bits. Every address must fit in them.
+    uint32_t address_bits;
+    // The replacement policy when the mapping is Set Associative
+    const replacement_policy_t *policy;
+    // Whether every miss is classified as compulsory, capacity or conflict
+    int classify_misses;
+    // When stores reach the next level
+    write_policy_t write_policy;
+    // What a store that misses does
+    write_miss_t write_miss;
+    // The prefetcher of each cache, or NULL for none
+    const prefetcher_t *prefetcher;
+    // How far ahead the prefetcher fetches
+    uint32_t prefetch_degree;
+    // The number of demand accesses a prefetch takes to arrive
+    uint32_t prefetch_latency;
+} cache_config_t;
+
+// Returns a description of why a configuration cannot be simulated, or NULL if
+// it can
+const char *cache_config_error(const cache_config_t *config);
+
+// Adds the statistics in `part` to `total`
+void cache_stat_add(cache_stat_t *total, const cache_stat_t *part);
+
+// Parses a cache size in bytes. Returns 0 on success, or -1 if it is not a
+// positive number.
+int parse_cache_size(const char *str, uint32_t *size);
+
+// Parses a cache mapping ("dm", "fa" or "sa<ways>", e.g. "sa4"). `ways` is
+// only set for Set Associative mappings. Returns 0 on success, or -1 if the
+// mapping is unknown.
+int parse_cache_mapping(const char *str, cache_map_t *mapping,
+                        uint32_t *ways);
+
+// Parses a cache organization ("uc" or "sc"). Returns 0 on success, or -1 if
+// the organization is unknown.
+int parse_cache_org(const char *str, cache_org_t *org);
+
+// Parses a cache configuration written as
+// "<size>:<mapping>:<organization>[:<policy>]", e.g. "1024:dm:uc" or
+// "4096:sa4:sc:plru". Set Associative caches default to LRU, and every cache to
+// DEFAULT_BLOCK_SIZE byte blocks of DEFAULT_ADDRESS_BITS bit addresses,
+// write-back and write-allocate without a prefetcher. Returns 0 on success, or
+// -1 if it is invalid.
+int parse_cache_config(const char *spec, cache_config_t *config);
+
+// Sets the replacement policy of a configuration from its name, or to the
+// default if `str` is NULL. Only Set Associative caches accept a policy.
+// Returns 0 on success, or -1 if the policy is unknown or not allowed.
+int parse_cache_policy(const char *str, cache_config_t *config);
+
+// Parses a write policy ("wb" or "wt"). Returns 0 on success, or -1 if the
+// policy is unknown.
+int parse_write_policy(const char *str, write_policy_t *policy);
+
+// Parses what a store miss does ("wa" or "nwa"). Returns 0 on success, or -1
+// if it is unknown.
+int parse_write_miss(const char *str, write_miss_t *miss);
+
+// Writes the command-line name of a cache mapping, e.g. "sa4", to `buf`
+void format_cache_mapping(const cache_config_t *config, char *buf,
+                          size_t size);
+
+// Returns the name of the replacement policy of a configuration
+const char *cache_policy_name(const cache_config_t *config);
+
+// Returns the command-line name of a cache organization
+const char *cache_org_name(cache_org_t org);
+
+// Parses a prefetcher written as "<name>[:<degree>]", e.g. "stride:4". Returns
+// 0 on success, or -1 if it is unknown or the degree is out of range.
+int parse_prefetcher(const char *str, const prefetcher_t **prefetcher,
+                     uint32_t *degree);
+
+#endif
@@ -0,0 +1,184 @@
+#include "stackdist.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// The initial number of time slots and hash map entries
+enum { INITIAL_CAPACITY = 1 << 16 };
+
+// Adds one to time slot `slot` in the Fenwick tree
+static void tree_increment(stack_distance_t *const sd, uint32_t slot) {
+    for (; slot <= sd->capacity; slot += slot & -slot) {
+        sd->tree[slot]++;
+    }
+}
+
+// Subtracts one from time slot `slot` in the Fenwick tree
+static void tree_decrement(stack_distance_t *const sd, uint32_t slot) {
+    for (; slot <= sd->capacity; slot += slot & -slot) {
+        sd->tree[slot]--;
+    }
+}
+
+// Returns the sum of time slots 1 to `slot` in the Fenwick tree
+static uint32_t tree_prefix(const stack_distance_t *const sd, uint32_t slot) {
+    uint32_t sum = 0;
+    for (; slot > 0; slot -= slot & -slot) {
+        sum += sd->tree[slot];
+    }
+    return sum;
+}
+
+// Returns the index of `key` in the hash map, or of the empty entry where it
+// would be inserted
+static size_t map_find(const stack_distance_t *const sd, const uint64_t key) {
+    const size_t mask = sd->map_capacity - 1;
+    size_t i = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+    while (sd->keys[i] != 0 && sd->keys[i] != key) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+// Doubles the size of the hash map
+static void map_grow(stack_distance_t *const sd) {
+    uint64_t *const old_keys = sd->keys;
+    uint32_t *const old_slots = sd->slots;
+    const size_t old_capacity = sd->map_capacity;
+
+    sd->map_capacity *= 2;
+    sd->keys = calloc(sd->map_capacity, sizeof(uint64_t));
+    sd->slots = malloc(sd->map_capacity * sizeof(uint32_t));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] != 0) {
+            const size_t j = map_find(sd, old_keys[i]);
+            sd->keys[j] = old_keys[i];
+            sd->slots[j] = old_slots[i];
+        }
+    }
+
+    free(old_keys);
+    free(old_slots);
+}
+
+// Moves the most recent access of every block to the front of the time slots,
+// keeping their order. The number of slots is doubled first if more than half
+// of them would still be in use.
+static void compact(stack_distance_t *const sd) {
+    uint32_t capacity = sd->capacity;
+    if (sd->map_count > capacity / 2) {
+        capacity *= 2;
+    }
+
+    uint64_t *const owners = calloc((size_t)capacity + 1, sizeof(uint64_t));
+    uint32_t next = 1;
+    for (uint32_t slot = 1; slot < sd->time; slot++) {
+        const uint64_t key = sd->owners[slot];
+        if (key != 0) {
+            owners[next] = key;
+            sd->slots[map_find(sd, key)] = next;
+            next++;
+        }
+    }
+
+    // A block inserted by the current access has no slot yet
+    const uint32_t live = next - 1;
+
+    free(sd->owners);
+    free(sd->tree);
+    sd->owners = owners;
+    sd->capacity = capacity;
+    sd->time = next;
+
+    // Build the tree with a one in every live slot in linear time
+    sd->tree = calloc((size_t)capacity + 1, sizeof(uint32_t));
+    for (uint32_t slot = 1; slot <= capacity; slot++) {
+        if (slot <= live) {
+            sd->tree[slot]++;
+        }
+        const uint32_t parent = slot + (slot & -slot);
+        if (parent <= capacity) {
+            sd->tree[parent] += sd->tree[slot];
+        }
+    }
+}
+
+void stack_distance_init(stack_distance_t *const sd,
+                         const size_t max_distance) {
+    sd->capacity = INITIAL_CAPACITY;
+    sd->time = 1;
+    sd->tree = calloc((size_t)sd->capacity + 1, sizeof(uint32_t));
+    sd->owners = calloc((size_t)sd->capacity + 1, sizeof(uint64_t));
+
+    sd->map_capacity = INITIAL_CAPACITY;
+    sd->map_count = 0;
+    sd->keys = calloc(sd->map_capacity, sizeof(uint64_t));
+    sd->slots = malloc(sd->map_capacity * sizeof(uint32_t));
+
+    sd->max_distance = max_distance;
+    sd->histogram = calloc(max_distance, sizeof(uint64_t));
+    sd->far = 0;
+    sd->cold = 0;
+}
+
+void stack_distance_free(stack_distance_t *const sd) {
+    free(sd->tree);
+    free(sd->owners);
+    free(sd->keys);
+    free(sd->slots);
+    free(sd->histogram);
+    memset(sd, 0, sizeof(stack_distance_t));
+}
+
+uint64_t stack_distance_access(stack_distance_t *const sd,
+                               const uint64_t block) {
+    // Zero marks an empty hash map entry and slot
+    const uint64_t key = block + 1;
+    size_t i = map_find(sd, key);
+    uint64_t distance;
+
+    if (sd->keys[i] == key) {
+        // Every live block has exactly one marked slot, so the blocks accessed
+        // since this one are the marks after its slot
+        const uint32_t slot = sd->slots[i];
+        distance = sd->map_count - tree_prefix(sd, slot);
+        tree_decrement(sd, slot);
+        sd->owners[slot] = 0;
+
+        if (distance < sd->max_distance) {
+            sd->histogram[distance]++;
+        } else {
+            sd->far++;
+        }
+    } else {
+        distance = STACK_DISTANCE_COLD;
+        sd->cold++;
+
+        if (2 * (sd->map_count + 1) > sd->map_capacity) {
+            map_grow(sd);
+            i = map_find(sd, key);
+        }
+        sd->keys[i] = key;
+        sd->map_count++;
+    }
+
+    if (sd->time > sd->capacity) {
+        compact(sd);
+    }
+
+    sd->slots[i] = sd->time;
+    sd->owners[sd->time] = key;
+    tree_increment(sd, sd->time);
+    sd->time++;
+
+    return distance;
+}
+
+uint64_t stack_distance_hits(const stack_distance_t *const sd,
+                             const size_t lines) {
+    uint64_t hits = 0;
+    for (size_t d = 0; d < lines && d < sd->max_distance; d++) {
+        hits += sd->histogram[d];
+    }
+    return hits;
+}
@@ -0,0 +1,65 @@
+#ifndef STACKDIST_H
+#define STACKDIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Computes LRU stack distances (Mattson et al.) of a stream of block
+// accesses. The stack distance of an access is the number of distinct blocks
+// accessed since the previous access to the same block, so the access hits in
+// a fully associative LRU cache of n lines exactly when its distance is less
+// than n. One pass therefore gives the hit rate of every cache size.
+//
+// Each access costs O(log n): a Fenwick tree over access times marks the most
+// recent access of every block, and the distance is the number of marks after
+// the block's previous access. When the tree fills up, the live marks are
+// compacted to the front, so memory stays proportional to the number of
+// distinct blocks rather than the trace length.
+typedef struct {
+    // Fenwick tree over the time slots, counting the slots that hold the most
+    // recent access of a block
+    uint32_t *tree;
+    // The block (plus one) whose most recent access is in each slot, or zero
+    uint64_t *owners;
+    // The number of time slots
+    uint32_t capacity;
+    // The next time slot, starting at one
+    uint32_t time;
+
+    // Open addressing hash map from block (plus one) to its latest time slot
+    uint64_t *keys;
+    uint32_t *slots;
+    // The size of the hash map, a power of two
+    size_t map_capacity;
+    // The number of blocks in the hash map
+    size_t map_count;
+
+    // The number of accesses with each stack distance below `max_distance`
+    uint64_t *histogram;
+    // The number of distances counted individually in `histogram`
+    size_t max_distance;
+    // The number of accesses with a distance of at least `max_distance`
+    uint64_t far;
+    // The number of first accesses to a block (infinite distance)
+    uint64_t cold;
+} stack_distance_t;
+
+// Returned by stack_distance_access() for the first access to a block
+#define STACK_DISTANCE_COLD UINT64_MAX
+
+// Initializes an engine that keeps a histogram of the distances below
+// `max_distance`
+void stack_distance_init(stack_distance_t *sd, size_t max_distance);
+
+// Frees the memory of the engine
+void stack_distance_free(stack_distance_t *sd);
+
+// Records an access to `block` and returns its stack distance, or
+// STACK_DISTANCE_COLD if the block was never accessed before
+uint64_t stack_distance_access(stack_distance_t *sd, uint64_t block);
+
+// Returns how many of the recorded accesses hit in a fully associative LRU
+// cache with `lines` lines. `lines` must be at most `max_distance`.
+uint64_t stack_distance_hits(const stack_distance_t *sd, size_t lines);
+
+#endif
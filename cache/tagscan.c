@@ -0,0 +1,173 @@
+#include "tagscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Returns the `n` (at most 32) valid bits starting at line `first`
+static inline uint32_t valid_bits(const uint64_t *const valid,
+                                  const uint32_t first, const uint32_t n) {
+    const uint32_t word = first / 64;
+    const uint32_t shift = first % 64;
+    uint64_t bits = valid[word] >> shift;
+    // The bits continue in the next word
+    if (shift + n > 64) {
+        bits |= valid[word + 1] << (64 - shift);
+    }
+    return (uint32_t)(bits & ((1ULL << n) - 1));
+}
+
+int32_t tag_find_scalar(const uint32_t *const tags,
+                        const uint64_t *const valid, const uint32_t first,
+                        const uint32_t count, const uint32_t tag) {
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t line = first + i;
+        if (tags[line] == tag && (valid[line / 64] >> (line % 64)) & 1) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+int32_t tag_find64_scalar(const uint64_t *const tags,
+                          const uint64_t *const valid, const uint32_t first,
+                          const uint32_t count, const uint64_t tag) {
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t line = first + i;
+        if (tags[line] == tag && (valid[line / 64] >> (line % 64)) & 1) {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2"))) int32_t
+tag_find_sse2(const uint32_t *const tags, const uint64_t *const valid,
+              const uint32_t first, const uint32_t count, const uint32_t tag) {
+    const __m128i needle = _mm_set1_epi32((int)tag);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const __m128i group =
+            _mm_loadu_si128((const __m128i *)(tags + first + i));
+        const uint32_t equal =
+            (uint32_t)_mm_movemask_ps(
+                _mm_castsi128_ps(_mm_cmpeq_epi32(group, needle))) &
+            valid_bits(valid, first + i, 4);
+        if (equal != 0) {
+            return (int32_t)(i + (uint32_t)__builtin_ctz(equal));
+        }
+    }
+
+    const int32_t rest =
+        tag_find_scalar(tags, valid, first + i, count - i, tag);
+    return rest < 0 ? -1 : (int32_t)i + rest;
+}
+
+__attribute__((target("avx2"))) int32_t
+tag_find_avx2(const uint32_t *const tags, const uint64_t *const valid,
+              const uint32_t first, const uint32_t count, const uint32_t tag) {
+    const __m256i needle = _mm256_set1_epi32((int)tag);
+    uint32_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        const __m256i group =
+            _mm256_loadu_si256((const __m256i *)(tags + first + i));
+        const uint32_t equal =
+            (uint32_t)_mm256_movemask_ps(
+                _mm256_castsi256_ps(_mm256_cmpeq_epi32(group, needle))) &
+            valid_bits(valid, first + i, 8);
+        if (equal != 0) {
+            return (int32_t)(i + (uint32_t)__builtin_ctz(equal));
+        }
+    }
+
+    // Calling the SSE2 search from here would mix VEX and legacy SSE code, so
+    // the last few lines are compared one at a time
+    const int32_t rest =
+        tag_find_scalar(tags, valid, first + i, count - i, tag);
+    return rest < 0 ? -1 : (int32_t)i + rest;
+}
+
+__attribute__((target("sse2"))) int32_t
+tag_find64_sse2(const uint64_t *const tags, const uint64_t *const valid,
+                const uint32_t first, const uint32_t count,
+                const uint64_t tag) {
+    const __m128i needle = _mm_set1_epi64x((long long)tag);
+    uint32_t i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        const __m128i group =
+            _mm_loadu_si128((const __m128i *)(tags + first + i));
+        // SSE2 only compares 32-bit lanes, so a tag is equal if both halves
+        // of its lane are
+        const __m128i halves = _mm_cmpeq_epi32(group, needle);
+        const __m128i both = _mm_and_si128(
+            halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+        const uint32_t equal =
+            (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(both)) &
+            valid_bits(valid, first + i, 2);
+        if (equal != 0) {
+            return (int32_t)(i + (uint32_t)__builtin_ctz(equal));
+        }
+    }
+
+    const int32_t rest =
+        tag_find64_scalar(tags, valid, first + i, count - i, tag);
+    return rest < 0 ? -1 : (int32_t)i + rest;
+}
+
+__attribute__((target("avx2"))) int32_t
+tag_find64_avx2(const uint64_t *const tags, const uint64_t *const valid,
+                const uint32_t first, const uint32_t count,
+                const uint64_t tag) {
+    const __m256i needle = _mm256_set1_epi64x((long long)tag);
+    uint32_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const __m256i group =
+            _mm256_loadu_si256((const __m256i *)(tags + first + i));
+        const uint32_t equal =
+            (uint32_t)_mm256_movemask_pd(
+                _mm256_castsi256_pd(_mm256_cmpeq_epi64(group, needle))) &
+            valid_bits(valid, first + i, 4);
+        if (equal != 0) {
+            return (int32_t)(i + (uint32_t)__builtin_ctz(equal));
+        }
+    }
+
+    // The last few lines are compared one at a time, as in tag_find_avx2
+    const int32_t rest =
+        tag_find64_scalar(tags, valid, first + i, count - i, tag);
+    return rest < 0 ? -1 : (int32_t)i + rest;
+}
+
+tag_find_fn tag_find_select(void) {
+    if (__builtin_cpu_supports("avx2")) {
+        return tag_find_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return tag_find_sse2;
+    }
+    return tag_find_scalar;
+}
+
+tag_find64_fn tag_find64_select(void) {
+    if (__builtin_cpu_supports("avx2")) {
+        return tag_find64_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return tag_find64_sse2;
+    }
+    return tag_find64_scalar;
+}
+
+#else
+
+tag_find_fn tag_find_select(void) { return tag_find_scalar; }
+
+tag_find64_fn tag_find64_select(void) { return tag_find64_scalar; }
+
+#endif
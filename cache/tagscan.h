@@ -0,0 +1,53 @@
+#ifndef TAGSCAN_H
+#define TAGSCAN_H
+
+#include <stdint.h>
+
+// Searches lines `first` to `first + count - 1` of a structure-of-arrays cache
+// for a valid line with `tag`. `tags` holds the tag of every line and `valid`
+// is a bitmap with one bit per line. Returns the position of the line
+// relative to `first`, or -1 if there is none.
+typedef int32_t (*tag_find_fn)(const uint32_t *tags, const uint64_t *valid,
+                               uint32_t first, uint32_t count, uint32_t tag);
+
+// Compares one tag at a time
+int32_t tag_find_scalar(const uint32_t *tags, const uint64_t *valid,
+                        uint32_t first, uint32_t count, uint32_t tag);
+
+#if defined(__x86_64__) || defined(__i386__)
+// Compares 4 tags per instruction with SSE2
+int32_t tag_find_sse2(const uint32_t *tags, const uint64_t *valid,
+                      uint32_t first, uint32_t count, uint32_t tag);
+
+// Compares 8 tags per instruction with AVX2. Only call this if the host
+// supports AVX2.
+int32_t tag_find_avx2(const uint32_t *tags, const uint64_t *valid,
+                      uint32_t first, uint32_t count, uint32_t tag);
+#endif
+
+// Searches the lines of a cache like a tag_find_fn, with 64-bit tags
+typedef int32_t (*tag_find64_fn)(const uint64_t *tags, const uint64_t *valid,
+                                 uint32_t first, uint32_t count, uint64_t tag);
+
+// Compares one 64-bit tag at a time
+int32_t tag_find64_scalar(const uint64_t *tags, const uint64_t *valid,
+                          uint32_t first, uint32_t count, uint64_t tag);
+
+#if defined(__x86_64__) || defined(__i386__)
+// Compares 2 64-bit tags per instruction with SSE2
+int32_t tag_find64_sse2(const uint64_t *tags, const uint64_t *valid,
+                        uint32_t first, uint32_t count, uint64_t tag);
+
+// Compares 4 64-bit tags per instruction with AVX2. Only call this if the
+// host supports AVX2.
+int32_t tag_find64_avx2(const uint64_t *tags, const uint64_t *valid,
+                        uint32_t first, uint32_t count, uint64_t tag);
+#endif
+
+// Returns the fastest tag search that the host supports
+tag_find_fn tag_find_select(void);
+
+// Returns the fastest 64-bit tag search that the host supports
+tag_find64_fn tag_find64_select(void);
+
+#endif
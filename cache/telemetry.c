@@ -0,0 +1,180 @@
+#define _DEFAULT_SOURCE
+
+#include "telemetry.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Returns the current time in seconds from a monotonic clock
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Returns hits / accesses, or 0 if there were no accesses
+static double rate(const uint64_t hits, const uint64_t accesses) {
+    return accesses == 0 ? 0.0 : (double)hits / (double)accesses;
+}
+
+// Writes a snapshot of the window from the previous snapshot to `stat`
+static void write_snapshot(telemetry_t *const telemetry,
+                           const cache_stat_t *const stat) {
+    const cache_stat_t *const last = &telemetry->last;
+    const double time = now();
+    const double seconds = time - telemetry->last_time;
+    const uint64_t accesses = stat->accesses - last->accesses;
+    const uint64_t hits = stat->hits - last->hits;
+    const uint64_t instr_accesses =
+        stat->instr_accesses - last->instr_accesses;
+    const uint64_t instr_hits = stat->instr_hits - last->instr_hits;
+    const uint64_t data_accesses = stat->data_accesses - last->data_accesses;
+    const uint64_t data_hits = stat->data_hits - last->data_hits;
+    const double throughput = seconds > 0 ? (double)accesses / seconds : 0.0;
+
+    if (telemetry->format == TELEMETRY_CSV) {
+        fprintf(telemetry->out,
+                "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.4f,%" PRIu64
+                ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                ",%.6f,%.6f,%.0f\n",
+                telemetry->window, stat->accesses, accesses, hits,
+                rate(hits, accesses), instr_accesses, instr_hits,
+                data_accesses, data_hits,
+                stat->compulsory_misses - last->compulsory_misses,
+                stat->capacity_misses - last->capacity_misses,
+                stat->conflict_misses - last->conflict_misses,
+                stat->writes - last->writes,
+                stat->writebacks - last->writebacks,
+                stat->bytes_read - last->bytes_read,
+                stat->bytes_written - last->bytes_written,
+                stat->prefetches_issued - last->prefetches_issued,
+                stat->prefetches_useful - last->prefetches_useful,
+                stat->prefetches_late - last->prefetches_late,
+                stat->prefetches_polluting - last->prefetches_polluting,
+                seconds, time - telemetry->start_time, throughput);
+    } else {
+        fprintf(telemetry->out,
+                "{\"window\":%" PRIu64 ",\"end\":%" PRIu64
+                ",\"accesses\":%" PRIu64 ",\"hits\":%" PRIu64
+                ",\"hit_rate\":%.4f,\"instr_accesses\":%" PRIu64
+                ",\"instr_hits\":%" PRIu64 ",\"data_accesses\":%" PRIu64
+                ",\"data_hits\":%" PRIu64 ",\"compulsory_misses\":%" PRIu64
+                ",\"capacity_misses\":%" PRIu64
+                ",\"conflict_misses\":%" PRIu64 ",\"writes\":%" PRIu64
+                ",\"writebacks\":%" PRIu64 ",\"bytes_read\":%" PRIu64
+                ",\"bytes_written\":%" PRIu64
+                ",\"prefetches_issued\":%" PRIu64
+                ",\"prefetches_useful\":%" PRIu64
+                ",\"prefetches_late\":%" PRIu64
+                ",\"prefetches_polluting\":%" PRIu64
+                ",\"seconds\":%.6f,\"elapsed\":%.6f"
+                ",\"accesses_per_sec\":%.0f}\n",
+                telemetry->window, stat->accesses, accesses, hits,
+                rate(hits, accesses), instr_accesses, instr_hits,
+                data_accesses, data_hits,
+                stat->compulsory_misses - last->compulsory_misses,
+                stat->capacity_misses - last->capacity_misses,
+                stat->conflict_misses - last->conflict_misses,
+                stat->writes - last->writes,
+                stat->writebacks - last->writebacks,
+                stat->bytes_read - last->bytes_read,
+                stat->bytes_written - last->bytes_written,
+                stat->prefetches_issued - last->prefetches_issued,
+                stat->prefetches_useful - last->prefetches_useful,
+                stat->prefetches_late - last->prefetches_late,
+                stat->prefetches_polluting - last->prefetches_polluting,
+                seconds, time - telemetry->start_time, throughput);
+    }
+    // Flush every window so a reader sees the progress as it happens
+    fflush(telemetry->out);
+
+    telemetry->window++;
+    telemetry->last = *stat;
+    telemetry->last_time = time;
+}
+
+int telemetry_open(telemetry_t *const telemetry, const int fd,
+                   const telemetry_format_t format, const uint64_t interval,
+                   const cache_stat_t *const stat) {
+    // Standard output is shared with the statistics, so its buffer is reused
+    // to keep the writes in order. Standard error stays open for the error
+    // messages after the telemetry is closed.
+    if (fd == STDOUT_FILENO) {
+        telemetry->out = stdout;
+        telemetry->owns_out = 0;
+    } else if (fd == STDERR_FILENO) {
+        telemetry->out = stderr;
+        telemetry->owns_out = 0;
+    } else {
+        // Any other descriptor is duplicated, so closing the stream leaves
+        // the caller's descriptor open
+        const int out_fd = dup(fd);
+        if (out_fd < 0) {
+            return -1;
+        }
+        telemetry->out = fdopen(out_fd, "w");
+        telemetry->owns_out = 1;
+        if (telemetry->out == NULL) {
+            close(out_fd);
+            return -1;
+        }
+    }
+
+    telemetry->format = format;
+    telemetry->interval = interval;
+    telemetry->window = 0;
+    telemetry->last = *stat;
+    telemetry->start_time = now();
+    telemetry->last_time = telemetry->start_time;
+
+    if (format == TELEMETRY_CSV) {
+        fprintf(telemetry->out,
+                "window,end,accesses,hits,hit_rate,instr_accesses,"
+                "instr_hits,data_accesses,data_hits,compulsory_misses,"
+                "capacity_misses,conflict_misses,writes,writebacks,"
+                "bytes_read,bytes_written,prefetches_issued,prefetches_useful,"
+                "prefetches_late,prefetches_polluting,seconds,elapsed,"
+                "accesses_per_sec\n");
+    }
+    return 0;
+}
+
+uint64_t telemetry_remaining(const telemetry_t *const telemetry,
+                             const cache_stat_t *const stat) {
+    return telemetry->interval - (stat->accesses - telemetry->last.accesses);
+}
+
+void telemetry_update(telemetry_t *const telemetry,
+                      const cache_stat_t *const stat) {
+    if (stat->accesses - telemetry->last.accesses >= telemetry->interval) {
+        write_snapshot(telemetry, stat);
+    }
+}
+
+void telemetry_close(telemetry_t *const telemetry,
+                     const cache_stat_t *const stat) {
+    if (stat->accesses != telemetry->last.accesses) {
+        write_snapshot(telemetry, stat);
+    }
+    if (telemetry->owns_out) {
+        fclose(telemetry->out);
+    } else {
+        fflush(telemetry->out);
+    }
+}
+
+int parse_telemetry_format(const char *const str,
+                           telemetry_format_t *const format) {
+    if (strcmp(str, "csv") == 0) {
+        *format = TELEMETRY_CSV;
+    } else if (strcmp(str, "json") == 0) {
+        *format = TELEMETRY_JSON;
+    } else {
+        return -1;
+    }
+    return 0;
+}
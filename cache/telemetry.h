@@ -0,0 +1,70 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "cache.h"
+
+// How telemetry snapshots are written
+typedef enum {
+    // One CSV row per window, after a header row
+    TELEMETRY_CSV,
+    // One JSON object per line
+    TELEMETRY_JSON
+} telemetry_format_t;
+
+// Writes a snapshot of the statistics every `interval` accesses while a trace
+// is simulated, so phase behaviour and progress can be followed on long runs.
+// Each snapshot holds the statistics of its window (the difference from the
+// previous snapshot) and the simulation throughput over the window.
+//
+// The simulation loop asks telemetry_remaining() how many accesses are left in
+// the window once per batch and only splits the batches that cross a window,
+// so the per-access cost is unchanged.
+typedef struct {
+    // Where the snapshots are written
+    FILE *out;
+    // Whether `out` was opened on a duplicate of the descriptor for the
+    // telemetry and must be closed
+    int owns_out;
+    // How the snapshots are written
+    telemetry_format_t format;
+    // The number of accesses in each window
+    uint64_t interval;
+
+    // The number of windows written
+    uint64_t window;
+    // The statistics at the end of the previous window
+    cache_stat_t last;
+    // The time the simulation started and the previous window ended, in
+    // seconds
+    double start_time;
+    double last_time;
+} telemetry_t;
+
+// Starts writing snapshots every `interval` accesses to file descriptor `fd`,
+// for a simulation that starts at the statistics `stat` (nonzero when it is
+// resumed). `fd` stays open after telemetry_close(). Returns 0 on success, or
+// -1 if the descriptor cannot be written.
+int telemetry_open(telemetry_t *telemetry, int fd, telemetry_format_t format,
+                   uint64_t interval, const cache_stat_t *stat);
+
+// Returns the number of accesses that can be simulated before the current
+// window is complete
+uint64_t telemetry_remaining(const telemetry_t *telemetry,
+                             const cache_stat_t *stat);
+
+// Writes a snapshot of the window ending at the current statistics if it is
+// complete
+void telemetry_update(telemetry_t *telemetry, const cache_stat_t *stat);
+
+// Writes the last, partial window if it has any accesses and stops writing
+// snapshots
+void telemetry_close(telemetry_t *telemetry, const cache_stat_t *stat);
+
+// Parses a telemetry format ("csv" or "json"). Returns 0 on success, or -1 if
+// the format is unknown.
+int parse_telemetry_format(const char *str, telemetry_format_t *format);
+
+#endif
@@ -0,0 +1,644 @@
+#define _DEFAULT_SOURCE
+
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The value of each hexadecimal digit plus one, or zero for any other
+// character
+static const uint8_t hex_value[256] = {
+    ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,  ['5'] = 6,
+    ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10, ['a'] = 11, ['b'] = 12,
+    ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16, ['A'] = 11, ['B'] = 12,
+    ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+static int is_space(const char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Reads a 32-bit little-endian integer
+static uint32_t load_u32(const char *const p) {
+    const uint8_t *const b = (const uint8_t *)p;
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 |
+           (uint32_t)b[3] << 24;
+}
+
+// Detects the format of the trace from its first bytes
+static void detect_format(trace_reader_t *const reader) {
+    reader->format = TRACE_TEXT;
+    reader->version = 0;
+    reader->wide_mask = 0;
+    reader->block_remaining = 0;
+
+    if (reader->filled - reader->pos >= TRACE_BINARY_HEADER_SIZE &&
+        memcmp(reader->pos, TRACE_BINARY_MAGIC, 4) == 0) {
+        reader->format = TRACE_BINARY;
+        reader->version = load_u32(reader->pos + 4);
+        reader->pos += TRACE_BINARY_HEADER_SIZE;
+    }
+
+    reader->block_end = reader->pos;
+}
+
+// Moves the unparsed bytes of a streamed trace to the start of the buffer and
+// reads until the buffer is full or the stream ends. Returns 0 on success, or
+// -1 if reading failed.
+static int fill_buffer(trace_reader_t *const reader) {
+    const size_t kept = (size_t)(reader->filled - reader->pos);
+    reader->buffer_offset += (uint64_t)(reader->pos - reader->buffer);
+    memmove(reader->buffer, reader->pos, kept);
+    reader->pos = reader->buffer;
+    reader->block_end = reader->buffer;
+
+    char *filled = reader->buffer + kept;
+    char *const buffer_end = reader->buffer + TRACE_STREAM_BUFFER_SIZE;
+    while (filled < buffer_end && !reader->eof) {
+        const ssize_t n =
+            read(reader->fd, filled, (size_t)(buffer_end - filled));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            reader->filled = filled;
+            reader->end = reader->pos;
+            return -1;
+        }
+        if (n == 0) {
+            reader->eof = 1;
+        }
+        filled += n;
+    }
+    reader->filled = filled;
+
+    return 0;
+}
+
+// Sets the end of a streamed trace to the end of the last complete line or
+// block in the buffer, so the parsers never see a partial access
+static void find_parse_end(trace_reader_t *const reader) {
+    const char *end = reader->filled;
+
+    if (!reader->eof) {
+        const char *p = reader->pos;
+        if (reader->format == TRACE_TEXT) {
+            while (end > p && end[-1] != '\n') {
+                end--;
+            }
+        } else {
+            while (reader->filled - p >= TRACE_BLOCK_HEADER_SIZE &&
+                   (size_t)(reader->filled - p - TRACE_BLOCK_HEADER_SIZE) >=
+                       load_u32(p + 4)) {
+                p += TRACE_BLOCK_HEADER_SIZE + load_u32(p + 4);
+            }
+            end = p;
+        }
+
+        // A line or block larger than the whole buffer is corrupt, so let the
+        // parser report it
+        if (end == reader->pos) {
+            end = reader->filled;
+        }
+    }
+
+    reader->end = end;
+}
+
+int trace_open(trace_reader_t *const reader, const char *const path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    // Pipes and other special files cannot be mapped
+    if (!S_ISREG(st.st_mode)) {
+        if (trace_open_fd(reader, fd) < 0) {
+            close(fd);
+            return -1;
+        }
+        reader->owns_fd = 1;
+        return 0;
+    }
+
+    reader->data = NULL;
+    reader->size = (size_t)st.st_size;
+
+    // An empty file cannot be mapped, but it is still a valid (empty) trace
+    if (reader->size > 0) {
+        void *const data =
+            mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        // The trace is parsed front to back exactly once
+        madvise(data, reader->size, MADV_SEQUENTIAL);
+        reader->data = data;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    reader->fd = -1;
+    reader->owns_fd = 0;
+    reader->buffer = NULL;
+    reader->eof = 1;
+    reader->pos = reader->data;
+    reader->end = reader->data + reader->size;
+    reader->filled = reader->end;
+    detect_format(reader);
+
+    return 0;
+}
+
+int trace_open_fd(trace_reader_t *const reader, const int fd) {
+    reader->buffer = malloc(TRACE_STREAM_BUFFER_SIZE);
+    if (reader->buffer == NULL) {
+        return -1;
+    }
+
+    reader->data = NULL;
+    reader->size = 0;
+    reader->fd = fd;
+    reader->owns_fd = 0;
+    reader->eof = 0;
+    reader->buffer_offset = 0;
+    reader->pos = reader->buffer;
+    reader->filled = reader->buffer;
+
+    if (fill_buffer(reader) < 0) {
+        free(reader->buffer);
+        reader->buffer = NULL;
+        return -1;
+    }
+    detect_format(reader);
+    find_parse_end(reader);
+
+    return 0;
+}
+
+void trace_set_address_bits(trace_reader_t *const reader,
+                            const uint32_t bits) {
+    reader->wide_mask = bits >= MAX_ADDRESS_BITS ? 0 : UINT64_MAX << bits;
+}
+
+void trace_close(trace_reader_t *const reader) {
+    if (reader->data != NULL) {
+        munmap((void *)reader->data, reader->size);
+    }
+    free(reader->buffer);
+    if (reader->owns_fd) {
+        close(reader->fd);
+    }
+
+    reader->data = NULL;
+    reader->size = 0;
+    reader->buffer = NULL;
+    reader->fd = -1;
+    reader->owns_fd = 0;
+    reader->pos = NULL;
+    reader->end = NULL;
+    reader->filled = NULL;
+}
+
+trace_position_t trace_tell(const trace_reader_t *const reader) {
+    const char *const base =
+        reader->buffer != NULL ? reader->buffer : reader->data;
+    const uint64_t base_offset =
+        reader->buffer != NULL ? reader->buffer_offset : 0;
+    trace_position_t position = {.offset = 0, .skip = 0};
+
+    if (base == NULL) {
+        // An empty mapped trace
+        return position;
+    }
+    if (reader->format == TRACE_BINARY && reader->block_remaining > 0) {
+        // A binary block can only be decoded from its start
+        position.offset =
+            base_offset + (uint64_t)(reader->block_start - base);
+        position.skip =
+            load_u32(reader->block_start) - reader->block_remaining;
+    } else {
+        position.offset = base_offset + (uint64_t)(reader->pos - base);
+    }
+    return position;
+}
+
+// Moves a streamed trace to `offset` and refills the buffer from there.
+// Returns 0 on success, or -1 if the stream ends before `offset` or reading
+// fails.
+static int seek_stream(trace_reader_t *const reader, const uint64_t offset) {
+    // The descriptor is at the end of the buffered bytes
+    const uint64_t fd_offset =
+        reader->buffer_offset + (uint64_t)(reader->filled - reader->buffer);
+
+    if (lseek(reader->fd, (off_t)offset - (off_t)fd_offset, SEEK_CUR) >= 0) {
+        reader->buffer_offset = offset;
+        reader->pos = reader->buffer;
+        reader->filled = reader->buffer;
+        reader->eof = 0;
+    } else {
+        // Pipes cannot seek, so read and drop the bytes before `offset`
+        if (offset < reader->buffer_offset) {
+            return -1;
+        }
+        while (offset > reader->buffer_offset +
+                            (uint64_t)(reader->filled - reader->buffer)) {
+            if (reader->eof) {
+                return -1;
+            }
+            reader->pos = reader->filled;
+            if (fill_buffer(reader) < 0) {
+                return -1;
+            }
+        }
+        reader->pos = reader->buffer + (offset - reader->buffer_offset);
+    }
+
+    return fill_buffer(reader);
+}
+
+int trace_seek(trace_reader_t *const reader,
+               const trace_position_t position) {
+    if (reader->format == TRACE_BINARY
+            ? position.offset < TRACE_BINARY_HEADER_SIZE
+            : position.skip != 0) {
+        return -1;
+    }
+
+    if (reader->buffer == NULL) {
+        if (position.offset > reader->size) {
+            return -1;
+        }
+        reader->pos = reader->data + position.offset;
+    } else if (seek_stream(reader, position.offset) < 0) {
+        return -1;
+    }
+    reader->block_remaining = 0;
+    reader->block_end = reader->pos;
+    if (reader->buffer != NULL) {
+        find_parse_end(reader);
+    }
+
+    // Decode and drop the accesses of the block that were already read
+    mem_access_t skipped[256];
+    const size_t skipped_size = sizeof(skipped) / sizeof(skipped[0]);
+    uint32_t left = position.skip;
+    while (left > 0) {
+        const size_t max = left < skipped_size ? left : skipped_size;
+        trace_status_t status;
+        if (trace_read_batch(reader, skipped, max, &status) != max) {
+            return -1;
+        }
+        left -= (uint32_t)max;
+    }
+
+    return 0;
+}
+
+// Writes a 32-bit little-endian integer
+static void store_u32(uint8_t *const b, const uint32_t value) {
+    b[0] = (uint8_t)value;
+    b[1] = (uint8_t)(value >> 8);
+    b[2] = (uint8_t)(value >> 16);
+    b[3] = (uint8_t)(value >> 24);
+}
+
+static size_t read_text(trace_reader_t *const reader, mem_access_t *const out,
+                        const size_t max, trace_status_t *const status) {
+    const char *pos = reader->pos;
+    const char *const end = reader->end;
+    size_t count = 0;
+
+    *status = TRACE_OK;
+
+    while (count < max) {
+        // Skip the line break (and any blank lines) before the next access
+        while (pos < end && is_space(*pos)) {
+            pos++;
+        }
+        if (pos == end) {
+            *status = TRACE_END;
+            break;
+        }
+
+        // Each line is "<I|D|L|S> <hex address>"
+        access_t type = DATA;
+        uint8_t is_write = 0;
+        if (*pos == 'I') {
+            type = INSTRUCTION;
+        } else if (*pos == 'S') {
+            is_write = 1;
+        } else if (*pos != 'D' && *pos != 'L') {
+            *status = TRACE_BAD_TYPE;
+            break;
+        }
+        pos++;
+
+        while (pos < end && (*pos == ' ' || *pos == '\t')) {
+            pos++;
+        }
+
+        // Accept an optional "0x" prefix, like scanf's %x does
+        if (end - pos > 2 && pos[0] == '0' &&
+            (pos[1] == 'x' || pos[1] == 'X') &&
+            hex_value[(uint8_t)pos[2]] != 0) {
+            pos += 2;
+        }
+
+        const char *const digits = pos;
+        // Leading zeros do not count towards the 16 digits of a 64-bit
+        // address
+        while (pos < end && *pos == '0') {
+            pos++;
+        }
+        const char *const significant = pos;
+        uint64_t address = 0;
+        uint8_t digit;
+        while (pos < end && (digit = hex_value[(uint8_t)*pos]) != 0) {
+            address = (address << 4) | (uint64_t)(digit - 1);
+            pos++;
+        }
+        if (pos == digits || pos - significant > 16) {
+            *status = TRACE_BAD_ADDRESS;
+            break;
+        }
+        if ((address & reader->wide_mask) != 0) {
+            *status = TRACE_WIDE_ADDRESS;
+            break;
+        }
+
+        out[count].address = address;
+        out[count].accessType = type;
+        out[count].isWrite = is_write;
+        count++;
+    }
+
+    reader->pos = pos;
+
+    return count;
+}
+
+// Decodes a LEB128 varint that ends before `end` and holds `flag_bits` flag
+// bits below a 64-bit value. The whole varint can be wider than 64 bits, so
+// the flags and the value are decoded separately. Returns 0 if the varint is
+// truncated or too long.
+static int decode_varint(const char **const pos, const char *const end,
+                         const uint32_t flag_bits, uint32_t *const flags,
+                         uint64_t *const value) {
+    const char *p = *pos;
+    if (p == end) {
+        return 0;
+    }
+
+    uint8_t byte = (uint8_t)*p++;
+    *flags = byte & ((1U << flag_bits) - 1);
+    uint64_t result = (uint64_t)(byte & 0x7f) >> flag_bits;
+    unsigned shift = 7 - flag_bits;
+
+    while (byte & 0x80) {
+        if (p == end || shift >= 64) {
+            return 0;
+        }
+        byte = (uint8_t)*p++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    }
+
+    *pos = p;
+    *value = result;
+
+    return 1;
+}
+
+static size_t read_binary(trace_reader_t *const reader,
+                          mem_access_t *const out, const size_t max,
+                          trace_status_t *const status) {
+    const char *pos = reader->pos;
+    const char *block_end = reader->block_end;
+    uint32_t remaining = reader->block_remaining;
+    // Version 1 has no store bit
+    const uint32_t flag_bits = reader->version == 1 ? 1 : 2;
+    size_t count = 0;
+
+    *status = TRACE_OK;
+    if (reader->version != 1 && reader->version != TRACE_BINARY_VERSION) {
+        *status = TRACE_BAD_FORMAT;
+        return 0;
+    }
+
+    while (count < max) {
+        if (remaining == 0) {
+            if (pos != block_end) {
+                // The payload was larger than its accesses
+                *status = TRACE_BAD_FORMAT;
+                break;
+            }
+            if (pos == reader->end) {
+                *status = TRACE_END;
+                break;
+            }
+            if (reader->end - pos < TRACE_BLOCK_HEADER_SIZE) {
+                *status = TRACE_BAD_FORMAT;
+                break;
+            }
+
+            reader->block_start = pos;
+            remaining = load_u32(pos);
+            const uint32_t payload_size = load_u32(pos + 4);
+            pos += TRACE_BLOCK_HEADER_SIZE;
+            if ((size_t)(reader->end - pos) < payload_size) {
+                *status = TRACE_BAD_FORMAT;
+                break;
+            }
+            block_end = pos + payload_size;
+            reader->prev_address[INSTRUCTION] = 0;
+            reader->prev_address[DATA] = 0;
+            continue;
+        }
+
+        uint32_t flags;
+        uint64_t zigzag;
+        if (!decode_varint(&pos, block_end, flag_bits, &flags, &zigzag)) {
+            *status = TRACE_BAD_FORMAT;
+            break;
+        }
+
+        const access_t type = (flags & 1) ? DATA : INSTRUCTION;
+        const uint8_t is_write = (flags & 2) != 0;
+        // Undo the zigzag encoding
+        const uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+        const uint64_t address = reader->prev_address[type] + delta;
+        if ((address & reader->wide_mask) != 0) {
+            *status = TRACE_WIDE_ADDRESS;
+            break;
+        }
+        reader->prev_address[type] = address;
+
+        out[count].address = address;
+        out[count].accessType = type;
+        out[count].isWrite = is_write;
+        count++;
+        remaining--;
+    }
+
+    reader->pos = pos;
+    reader->block_end = block_end;
+    reader->block_remaining = remaining;
+
+    return count;
+}
+
+size_t trace_read_batch(trace_reader_t *const reader, mem_access_t *const out,
+                        const size_t max, trace_status_t *const status) {
+    size_t count = 0;
+
+    for (;;) {
+        if (reader->format == TRACE_BINARY) {
+            count += read_binary(reader, out + count, max - count, status);
+        } else {
+            count += read_text(reader, out + count, max - count, status);
+        }
+
+        // The parsers stop at the end of the complete lines or blocks in the
+        // buffer, so a streamed trace only ends once the stream has
+        if (*status != TRACE_END || reader->eof) {
+            return count;
+        }
+        if (fill_buffer(reader) < 0) {
+            *status = TRACE_READ_ERROR;
+            return count;
+        }
+        find_parse_end(reader);
+    }
+}
+
+mem_access_t *trace_read_all(trace_reader_t *const reader,
+                             size_t *const count,
+                             trace_status_t *const status) {
+    // Text lines are at least 4 bytes and binary accesses at least 1, so this
+    // is usually close to the final size
+    size_t capacity = (size_t)(reader->end - reader->pos) /
+                          (reader->format == TRACE_TEXT ? 8 : 2) +
+                      1;
+    mem_access_t *accesses = malloc(capacity * sizeof(mem_access_t));
+    *count = 0;
+    if (accesses == NULL) {
+        return NULL;
+    }
+
+    do {
+        if (*count == capacity) {
+            mem_access_t *const grown =
+                realloc(accesses, 2 * capacity * sizeof(mem_access_t));
+            if (grown == NULL) {
+                free(accesses);
+                *count = 0;
+                return NULL;
+            }
+            accesses = grown;
+            capacity *= 2;
+        }
+        *count += trace_read_batch(reader, accesses + *count,
+                                   capacity - *count, status);
+    } while (*status == TRACE_OK);
+
+    return accesses;
+}
+
+int trace_writer_open(trace_writer_t *const writer, const char *const path) {
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        return -1;
+    }
+
+    writer->block_count = 0;
+    writer->block_size = 0;
+    writer->prev_address[INSTRUCTION] = 0;
+    writer->prev_address[DATA] = 0;
+
+    uint8_t header[TRACE_BINARY_HEADER_SIZE];
+    memcpy(header, TRACE_BINARY_MAGIC, 4);
+    store_u32(header + 4, TRACE_BINARY_VERSION);
+    if (fwrite(header, sizeof(header), 1, writer->file) != 1) {
+        fclose(writer->file);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Writes the current block to the file and starts a new one
+static int flush_block(trace_writer_t *const writer) {
+    if (writer->block_count == 0) {
+        return 0;
+    }
+
+    uint8_t header[TRACE_BLOCK_HEADER_SIZE];
+    store_u32(header, writer->block_count);
+    store_u32(header + 4, (uint32_t)writer->block_size);
+    if (fwrite(header, sizeof(header), 1, writer->file) != 1 ||
+        fwrite(writer->block, 1, writer->block_size, writer->file) !=
+            writer->block_size) {
+        return -1;
+    }
+
+    writer->block_count = 0;
+    writer->block_size = 0;
+    writer->prev_address[INSTRUCTION] = 0;
+    writer->prev_address[DATA] = 0;
+
+    return 0;
+}
+
+int trace_write(trace_writer_t *const writer, const mem_access_t access) {
+    const uint64_t address = access.address;
+    const uint64_t delta = address - writer->prev_address[access.accessType];
+    writer->prev_address[access.accessType] = address;
+
+    // Zigzag encode the delta so small negative deltas stay small
+    const uint64_t zigzag = (delta << 1) ^ (0 - (delta >> 63));
+
+    // The flags and the low 5 bits of the zigzag value fill the first byte,
+    // so the 66-bit varint never needs a wider integer
+    uint8_t *out = writer->block + writer->block_size;
+    uint8_t byte = (uint8_t)((zigzag & 0x1f) << 2) |
+                   (access.isWrite ? 2 : 0) |
+                   (access.accessType == DATA ? 1 : 0);
+    uint64_t value = zigzag >> 5;
+    while (value != 0) {
+        *out++ = byte | 0x80;
+        byte = value & 0x7f;
+        value >>= 7;
+    }
+    *out++ = byte;
+    writer->block_size = (size_t)(out - writer->block);
+
+    if (++writer->block_count == TRACE_BLOCK_ACCESSES) {
+        return flush_block(writer);
+    }
+
+    return 0;
+}
+
+int trace_writer_close(trace_writer_t *const writer) {
+    int result = flush_block(writer);
+    if (fclose(writer->file) != 0) {
+        result = -1;
+    }
+    writer->file = NULL;
+
+    return result;
+}
@@ -0,0 +1,176 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "simtypes.h"
+
+// The result of reading from a trace
+typedef enum {
+    // The requested accesses were read
+    TRACE_OK,
+    // The end of the trace was reached
+    TRACE_END,
+    // A line had an access type other than 'I', 'D', 'L' or 'S'
+    TRACE_BAD_TYPE,
+    // A line did not contain a hexadecimal address of at most 64 bits
+    TRACE_BAD_ADDRESS,
+    // An address was wider than the address width of the reader
+    TRACE_WIDE_ADDRESS,
+    // A binary trace was truncated or corrupt
+    TRACE_BAD_FORMAT,
+    // Reading a streamed trace failed
+    TRACE_READ_ERROR,
+} trace_status_t;
+
+// The on-disk format of a trace
+typedef enum {
+    // One "<I|D|L|S> <hex address>" line per access: an instruction fetch,
+    // a data access, a load or a store. 'D' and 'L' are both data reads.
+    TRACE_TEXT,
+    // Blocks of delta encoded accesses, see trace_writer_t
+    TRACE_BINARY,
+} trace_format_t;
+
+// The magic bytes at the start of a binary trace
+#define TRACE_BINARY_MAGIC "CTRB"
+// The version of the binary trace format that is written. Version 1 traces,
+// which have no stores, are still read.
+enum { TRACE_BINARY_VERSION = 2 };
+// The size of the binary trace file header (magic and version)
+enum { TRACE_BINARY_HEADER_SIZE = 8 };
+// The size of a binary block header (access count and payload size)
+enum { TRACE_BLOCK_HEADER_SIZE = 8 };
+// The maximum number of accesses in a binary block
+enum { TRACE_BLOCK_ACCESSES = 4096 };
+// The maximum size of an encoded access in a binary block
+enum { TRACE_MAX_ENCODED_SIZE = 10 };
+// The size of the buffer a streamed trace is read into. It holds several of
+// the largest binary blocks.
+enum { TRACE_STREAM_BUFFER_SIZE = 1 << 20 };
+
+// A trace that is parsed in place. Regular files are memory mapped, anything
+// else (pipes, terminals, sockets) is streamed through a fixed size buffer, so
+// memory use does not grow with the trace. The format is detected from the
+// first bytes of the trace.
+typedef struct {
+    // The start of the mapped trace file, or NULL if the trace is streamed
+    const char *data;
+    // The size of the mapped trace file in bytes
+    size_t size;
+    // The next byte to parse
+    const char *pos;
+    // One past the last byte that can be parsed. For a streamed trace this is
+    // the end of the last complete line or block in the buffer.
+    const char *end;
+    // The format of the trace file
+    trace_format_t format;
+    // The version of a binary trace
+    uint32_t version;
+    // The address bits above the address width. An address with any of them
+    // set is rejected.
+    uint64_t wide_mask;
+
+    // The descriptor a streamed trace is read from, or -1 if it is mapped
+    int fd;
+    // Whether the descriptor is closed with the trace
+    int owns_fd;
+    // The buffer a streamed trace is read into, or NULL if it is mapped
+    char *buffer;
+    // One past the last byte read into the buffer
+    const char *filled;
+    // Whether the end of a streamed trace has been read into the buffer
+    int eof;
+    // The offset in the stream of the first byte of the buffer
+    uint64_t buffer_offset;
+
+    // Accesses left in the current binary block
+    uint32_t block_remaining;
+    // The header of the current binary block
+    const char *block_start;
+    // One past the last byte of the current binary block
+    const char *block_end;
+    // The previous address of each access type in the current binary block
+    uint64_t prev_address[2];
+} trace_reader_t;
+
+// Writes a binary trace.
+//
+// The file starts with TRACE_BINARY_MAGIC and the format version as a 32-bit
+// little-endian integer. It is followed by blocks of at most
+// TRACE_BLOCK_ACCESSES accesses. Each block starts with the number of accesses
+// and the payload size in bytes, both 32-bit little-endian. Every access in the
+// payload is one LEB128 varint holding the zigzag encoded difference from the
+// previous address of the same access type, shifted left by two, with whether
+// the access is a store in bit 1 and the access type in bit 0. The difference
+// is taken modulo 2^64, so the varint holds up to 66 bits. Version 1 had no
+// store bit and shifted the difference by one. The previous addresses are
+// reset to zero at the start of each block, so blocks can be decoded
+// independently.
+typedef struct {
+    // The output file
+    FILE *file;
+    // Accesses in the current block
+    uint32_t block_count;
+    // Bytes used in the current block payload
+    size_t block_size;
+    // The previous address of each access type in the current block
+    uint64_t prev_address[2];
+    // The payload of the current block
+    uint8_t block[TRACE_BLOCK_ACCESSES * TRACE_MAX_ENCODED_SIZE];
+} trace_writer_t;
+
+// Opens the text or binary trace at `path`. Regular files are memory mapped and
+// anything else is streamed. Returns 0 on success, or -1 with errno set on
+// failure.
+int trace_open(trace_reader_t *reader, const char *path);
+
+// Streams a text or binary trace from the descriptor `fd`, e.g. a pipe from a
+// decompressor on standard input. The descriptor is not closed with the trace.
+// Returns 0 on success, or -1 with errno set on failure.
+int trace_open_fd(trace_reader_t *reader, int fd);
+
+// Rejects the addresses of the trace that are wider than `bits` bits with
+// TRACE_WIDE_ADDRESS. Traces are opened with MAX_ADDRESS_BITS.
+void trace_set_address_bits(trace_reader_t *reader, uint32_t bits);
+
+// Unmaps or stops streaming the trace
+void trace_close(trace_reader_t *reader);
+
+// Parses up to `max` accesses into `out` and returns how many were parsed.
+// `status` is set to TRACE_OK if `max` accesses were parsed, otherwise it tells
+// why parsing stopped early.
+size_t trace_read_batch(trace_reader_t *reader, mem_access_t *out, size_t max,
+                        trace_status_t *status);
+
+// Parses the rest of the trace into a newly allocated array and returns it.
+// `count` is set to the number of accesses in the array and `status` to why
+// parsing stopped. The array must be freed by the caller. Returns NULL, with
+// `count` set to zero, if the array cannot be allocated.
+mem_access_t *trace_read_all(trace_reader_t *reader, size_t *count,
+                             trace_status_t *status);
+
+// Returns the position after the last access that was read
+trace_position_t trace_tell(const trace_reader_t *reader);
+
+// Continues reading at a position returned by trace_tell() for the same trace.
+// Mapped traces and seekable descriptors are positioned directly, other
+// streams are read up to the position. Returns 0 on success, or -1 if the
+// position is not in the trace or it cannot be read.
+int trace_seek(trace_reader_t *reader, trace_position_t position);
+
+// Creates the binary trace file at `path`. Returns 0 on success, or -1 with
+// errno set on failure.
+int trace_writer_open(trace_writer_t *writer, const char *path);
+
+// Appends an access to the binary trace. Returns 0 on success, or -1 if a
+// block could not be written.
+int trace_write(trace_writer_t *writer, mem_access_t access);
+
+// Writes the last block and closes the file. Returns 0 on success, or -1 if
+// the file could not be written.
+int trace_writer_close(trace_writer_t *writer);
+
+#endif
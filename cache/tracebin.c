@@ -0,0 +1,67 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+enum { BATCH_SIZE = 4096 };
+
+// Converts a text trace to the binary trace format
+int main(const int argc, const char **argv) {
+    if (argc != 3) {
+        printf("usage: tracebin <text trace> <binary trace>\n");
+        exit(1);
+    }
+
+    trace_reader_t trace;
+    if (trace_open(&trace, argv[1]) < 0) {
+        printf("Unable to open the trace file\n");
+        exit(1);
+    }
+    if (trace.format != TRACE_TEXT) {
+        printf("The input trace is not a text trace\n");
+        exit(1);
+    }
+
+    static trace_writer_t writer;
+    if (trace_writer_open(&writer, argv[2]) < 0) {
+        printf("Unable to create the binary trace file\n");
+        exit(1);
+    }
+
+    static mem_access_t batch[BATCH_SIZE];
+    trace_status_t status;
+    size_t accesses = 0;
+    do {
+        const size_t count =
+            trace_read_batch(&trace, batch, BATCH_SIZE, &status);
+        for (size_t i = 0; i < count; i++) {
+            if (trace_write(&writer, batch[i]) < 0) {
+                printf("Unable to write the binary trace file\n");
+                exit(1);
+            }
+        }
+        accesses += count;
+    } while (status == TRACE_OK);
+
+    if (status != TRACE_END) {
+        printf("Invalid line in the trace file\n");
+        exit(1);
+    }
+    if (trace_writer_close(&writer) < 0) {
+        printf("Unable to write the binary trace file\n");
+        exit(1);
+    }
+
+    struct stat st;
+    if (stat(argv[2], &st) == 0) {
+        printf("Converted %zu accesses: %zu bytes -> %lld bytes\n", accesses,
+               trace.size, (long long)st.st_size);
+    }
+
+    trace_close(&trace);
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload.h"
+
+enum { BATCH_SIZE = 4096 };
+
+// Prints the command-line usage and exits
+static void usage(void) {
+    printf("usage: tracegen [options] "
+           "<workload: sequential|strided|random|zipf|loop> <output trace>\n"
+           "\n"
+           "options:\n"
+           "  -n <accesses>    length of the trace (10000000)\n"
+           "  -f <bytes>       data footprint (1048576)\n"
+           "  -s <bytes>       stride of a strided workload (256)\n"
+           "  -z <exponent>    exponent of a Zipf workload (0.99)\n"
+           "  -i <percent>     share of instruction fetches (25)\n"
+           "  -w <percent>     share of data accesses that are stores (0)\n"
+           "  -r <seed>        random seed (1)\n"
+           "  -b               write the binary trace format\n"
+           "\n"
+           "The output trace is - for standard output.\n");
+    exit(1);
+}
+
+// Parses an unsigned decimal number. Returns 0 on success, or -1 if it is not
+// a number.
+static int parse_number(const char *const str, uint64_t *const value) {
+    char *end;
+    if (str[0] < '0' || str[0] > '9') {
+        return -1;
+    }
+    *value = strtoull(str, &end, 10);
+    return *end == '\0' ? 0 : -1;
+}
+
+// Writes a deterministic synthetic trace
+int main(const int argc, const char **argv) {
+    workload_config_t config;
+    workload_defaults(&config);
+    int binary = 0;
+
+    int arg = 1;
+    while (arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0') {
+        uint64_t value = 0;
+        if (strcmp(argv[arg], "-b") == 0) {
+            binary = 1;
+            arg++;
+            continue;
+        }
+        if (arg + 1 >= argc) {
+            usage();
+        }
+        if (strcmp(argv[arg], "-z") == 0) {
+            char *end;
+            config.zipf_exponent = strtod(argv[arg + 1], &end);
+            if (*end != '\0') {
+                usage();
+            }
+        } else if (parse_number(argv[arg + 1], &value) < 0) {
+            usage();
+        } else if (strcmp(argv[arg], "-n") == 0) {
+            config.length = value;
+        } else if (strcmp(argv[arg], "-f") == 0 && value <= UINT32_MAX) {
+            config.footprint = (uint32_t)value;
+        } else if (strcmp(argv[arg], "-s") == 0 && value <= UINT32_MAX) {
+            config.stride = (uint32_t)value;
+        } else if (strcmp(argv[arg], "-i") == 0 && value <= 100) {
+            config.instr_percent = (uint32_t)value;
+        } else if (strcmp(argv[arg], "-w") == 0 && value <= 100) {
+            config.store_percent = (uint32_t)value;
+        } else if (strcmp(argv[arg], "-r") == 0) {
+            config.seed = value;
+        } else {
+            usage();
+        }
+        arg += 2;
+    }
+
+    if (argc - arg != 2 || parse_workload_kind(argv[arg], &config.kind) < 0) {
+        usage();
+    }
+    const char *const error = workload_config_error(&config);
+    if (error != NULL) {
+        printf("%s\n", error);
+        exit(1);
+    }
+    const char *const path = argv[arg + 1];
+    const int to_stdout = strcmp(path, "-") == 0;
+
+    static trace_writer_t writer;
+    FILE *text = NULL;
+    if (binary) {
+        if (trace_writer_open(&writer, to_stdout ? "/dev/stdout" : path) < 0) {
+            printf("Unable to create the trace file\n");
+            exit(1);
+        }
+    } else {
+        text = to_stdout ? stdout : fopen(path, "w");
+        if (text == NULL) {
+            printf("Unable to create the trace file\n");
+            exit(1);
+        }
+    }
+
+    workload_t workload;
+    workload_init(&workload, &config);
+
+    static mem_access_t batch[BATCH_SIZE];
+    size_t count;
+    int failed = 0;
+    while (!failed &&
+           (count = workload_generate(&workload, batch, BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (binary) {
+                failed |= trace_write(&writer, batch[i]) < 0;
+            } else {
+                const char type = batch[i].accessType == INSTRUCTION ? 'I'
+                                  : batch[i].isWrite                 ? 'S'
+                                                                     : 'D';
+                failed |= fprintf(text, "%c %" PRIx64 "\n", type,
+                                  batch[i].address) < 0;
+            }
+        }
+    }
+
+    if (binary) {
+        failed |= trace_writer_close(&writer) < 0;
+    } else {
+        failed |= fclose(text) != 0;
+    }
+    if (failed) {
+        printf("Unable to write the trace file\n");
+        exit(1);
+    }
+
+    return 0;
+}
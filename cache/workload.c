@@ -0,0 +1,247 @@
+#include "workload.h"
+
+#include <math.h>
+#include <string.h>
+
+// Where the generated code and data live in the address space
+enum { CODE_BASE = 0x00400000, DATA_BASE = 0x10000000 };
+// The size of a data access and of an instruction
+enum { DATA_ACCESS_SIZE = 8, INSTRUCTION_SIZE = 4 };
+// The size of the blocks picked by a Zipf workload
+enum { ZIPF_BLOCK_SIZE = 64 };
+
+// The name of each workload kind
+static const char *const kind_names[] = {
+    [WORKLOAD_SEQUENTIAL] = "sequential",
+    [WORKLOAD_STRIDED] = "strided",
+    [WORKLOAD_RANDOM] = "random",
+    [WORKLOAD_ZIPF] = "zipf",
+    [WORKLOAD_LOOP] = "loop",
+};
+
+// A splitmix64 pseudo-random number generator. Unlike xorshift it accepts any
+// seed, including zero.
+static uint64_t next_random(uint64_t *const state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Returns a uniformly random number in [0, 1)
+static double next_uniform(uint64_t *const state) {
+    return (double)(next_random(state) >> 11) * 0x1.0p-53;
+}
+
+// Returns a random number in [0, bound). The modulo bias is negligible for
+// bounds far below 2^64.
+static uint64_t next_below(uint64_t *const state, const uint64_t bound) {
+    return next_random(state) % bound;
+}
+
+// The Zipf sampler uses the rejection-inversion method of Hörmann and
+// Derflinger, which draws a rank in constant expected time without a table of
+// the whole distribution. The helpers stay accurate when the exponent is close
+// to one.
+
+// Returns log1p(x) / x
+static double zipf_helper1(const double x) {
+    if (fabs(x) > 1e-8) {
+        return log1p(x) / x;
+    }
+    return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+// Returns expm1(x) / x
+static double zipf_helper2(const double x) {
+    if (fabs(x) > 1e-8) {
+        return expm1(x) / x;
+    }
+    return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+// The integral of the hat function
+static double zipf_h_integral(const double s, const double x) {
+    const double log_x = log(x);
+    return zipf_helper2((1.0 - s) * log_x) * log_x;
+}
+
+// The hat function, x^-s
+static double zipf_h(const double s, const double x) {
+    return exp(-s * log(x));
+}
+
+// The inverse of zipf_h_integral
+static double zipf_h_integral_inverse(const double s, const double x) {
+    double t = x * (1.0 - s);
+    if (t < -1.0) {
+        // Rounding errors can push t just past the domain of log1p
+        t = -1.0;
+    }
+    return exp(zipf_helper1(t) * x);
+}
+
+// Returns a Zipf distributed rank from 1 to `n`, where rank 1 is the most
+// popular
+static uint64_t zipf_sample(workload_t *const workload, const uint64_t n) {
+    const double s = workload->config.zipf_exponent;
+
+    for (;;) {
+        const double u =
+            workload->zipf_h_n + next_uniform(&workload->random) *
+                                     (workload->zipf_h_x1 - workload->zipf_h_n);
+        const double x = zipf_h_integral_inverse(s, u);
+        double k = floor(x + 0.5);
+        if (k < 1.0) {
+            k = 1.0;
+        } else if (k > (double)n) {
+            k = (double)n;
+        }
+        if (k - x <= workload->zipf_s ||
+            u >= zipf_h_integral(s, k + 0.5) - zipf_h(s, k)) {
+            return (uint64_t)k;
+        }
+    }
+}
+
+// Returns the number of blocks a Zipf workload picks from
+static uint64_t zipf_blocks(const workload_config_t *const config) {
+    const uint64_t blocks = config->footprint / ZIPF_BLOCK_SIZE;
+    return blocks > 0 ? blocks : 1;
+}
+
+void workload_defaults(workload_config_t *const config) {
+    config->kind = WORKLOAD_LOOP;
+    config->length = 10000000;
+    config->footprint = 1 << 20;
+    config->stride = 256;
+    config->zipf_exponent = 0.99;
+    config->instr_percent = 25;
+    config->store_percent = 0;
+    config->seed = 1;
+}
+
+const char *workload_config_error(const workload_config_t *const config) {
+    if (config->footprint < DATA_ACCESS_SIZE ||
+        config->footprint > 0xf0000000U - DATA_BASE) {
+        return "The footprint must be between 8 bytes and 3.5 GiB";
+    }
+    if (config->kind == WORKLOAD_STRIDED &&
+        (config->stride == 0 || config->stride >= config->footprint)) {
+        return "The stride must be positive and smaller than the footprint";
+    }
+    if (config->kind == WORKLOAD_ZIPF && !(config->zipf_exponent > 0.0)) {
+        return "The Zipf exponent must be positive";
+    }
+    if (config->instr_percent > 100) {
+        return "The instruction percentage must be at most 100";
+    }
+    if (config->store_percent > 100) {
+        return "The store percentage must be at most 100";
+    }
+    return NULL;
+}
+
+void workload_init(workload_t *const workload,
+                   const workload_config_t *const config) {
+    workload->config = *config;
+    workload->generated = 0;
+    workload->random = config->seed;
+    workload->pc = CODE_BASE;
+    workload->data = DATA_BASE;
+
+    if (config->kind == WORKLOAD_ZIPF) {
+        const double s = config->zipf_exponent;
+        const double n = (double)zipf_blocks(config);
+        workload->zipf_h_x1 = zipf_h_integral(s, 1.5) - 1.0;
+        workload->zipf_h_n = zipf_h_integral(s, n + 0.5);
+        workload->zipf_s =
+            2.0 - zipf_h_integral_inverse(
+                      s, zipf_h_integral(s, 2.5) - zipf_h(s, 2.0));
+    }
+}
+
+// Returns the address of the next data access
+static uint32_t next_data_address(workload_t *const workload) {
+    const workload_config_t *const config = &workload->config;
+    const uint32_t address = workload->data;
+
+    switch (config->kind) {
+    case WORKLOAD_SEQUENTIAL:
+        // Wraps around only after the whole 32-bit address space
+        workload->data += DATA_ACCESS_SIZE;
+        return address;
+    case WORKLOAD_STRIDED:
+        workload->data =
+            DATA_BASE + (address - DATA_BASE + config->stride) %
+                            config->footprint;
+        return address;
+    case WORKLOAD_RANDOM:
+        return DATA_BASE +
+               (uint32_t)next_below(&workload->random,
+                                    config->footprint / DATA_ACCESS_SIZE) *
+                   DATA_ACCESS_SIZE;
+    case WORKLOAD_ZIPF: {
+        const uint64_t blocks = zipf_blocks(config);
+        const uint64_t rank = zipf_sample(workload, blocks);
+        // Spread the popular blocks over the footprint instead of packing
+        // them together. The multiplier is odd, so this is a permutation when
+        // the number of blocks is a power of two.
+        const uint64_t block = (rank - 1) * 0x9e3779b1U % blocks;
+        return DATA_BASE + (uint32_t)block * ZIPF_BLOCK_SIZE;
+    }
+    case WORKLOAD_LOOP:
+        workload->data += DATA_ACCESS_SIZE;
+        if (workload->data - DATA_BASE >= config->footprint) {
+            workload->data = DATA_BASE;
+        }
+        return address;
+    }
+
+    return address;
+}
+
+size_t workload_generate(workload_t *const workload, mem_access_t *const out,
+                         const size_t max) {
+    const uint64_t left = workload->config.length - workload->generated;
+    const size_t count = left < max ? (size_t)left : max;
+
+    for (size_t i = 0; i < count; i++) {
+        if (next_below(&workload->random, 100) <
+            workload->config.instr_percent) {
+            out[i].address = workload->pc;
+            out[i].accessType = INSTRUCTION;
+            out[i].isWrite = 0;
+            workload->pc += INSTRUCTION_SIZE;
+            if (workload->pc == CODE_BASE + WORKLOAD_CODE_SIZE) {
+                workload->pc = CODE_BASE;
+            }
+        } else {
+            out[i].address = next_data_address(workload);
+            out[i].accessType = DATA;
+            // Only draw when there are stores, so load-only traces stay the
+            // same for a seed
+            out[i].isWrite = workload->config.store_percent > 0 &&
+                             next_below(&workload->random, 100) <
+                                 workload->config.store_percent;
+        }
+    }
+
+    workload->generated += count;
+
+    return count;
+}
+
+int parse_workload_kind(const char *const str, workload_kind_t *const kind) {
+    for (size_t i = 0; i < sizeof(kind_names) / sizeof(kind_names[0]); i++) {
+        if (strcmp(str, kind_names[i]) == 0) {
+            *kind = (workload_kind_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *workload_kind_name(const workload_kind_t kind) {
+    return kind_names[kind];
+}
@@ -0,0 +1,90 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+// The access pattern of a synthetic workload
+typedef enum {
+    // Streams through memory without ever returning to an address
+    WORKLOAD_SEQUENTIAL,
+    // Steps through the footprint `stride` bytes at a time, wrapping around
+    WORKLOAD_STRIDED,
+    // Picks uniformly random addresses in the footprint
+    WORKLOAD_RANDOM,
+    // Picks blocks of the footprint with Zipf distributed popularity
+    WORKLOAD_ZIPF,
+    // Loops sequentially over the footprint
+    WORKLOAD_LOOP,
+} workload_kind_t;
+
+// The parameters of a synthetic workload
+typedef struct {
+    // The access pattern of the data accesses
+    workload_kind_t kind;
+    // The number of accesses to generate
+    uint64_t length;
+    // The bytes of data the workload touches
+    uint32_t footprint;
+    // The distance between accesses of a strided workload in bytes
+    uint32_t stride;
+    // The exponent of a Zipf workload. Larger exponents make the most popular
+    // blocks more popular.
+    double zipf_exponent;
+    // The percentage of accesses that are sequential instruction fetches
+    uint32_t instr_percent;
+    // The percentage of data accesses that are stores
+    uint32_t store_percent;
+    // The seed of the random number generator. The same parameters and seed
+    // always give the same trace.
+    uint64_t seed;
+} workload_config_t;
+
+// A synthetic trace generator. The accesses are generated on the fly, so
+// traces of any length use constant memory.
+typedef struct {
+    // The parameters of the workload
+    workload_config_t config;
+    // The number of accesses generated so far
+    uint64_t generated;
+    // The state of the random number generator
+    uint64_t random;
+    // The next instruction address
+    uint32_t pc;
+    // The next data address of the sequential, strided and loop workloads
+    uint32_t data;
+
+    // The precomputed constants of the Zipf rejection-inversion sampler
+    double zipf_h_x1;
+    double zipf_h_n;
+    double zipf_s;
+} workload_t;
+
+// The bytes of code that the instruction fetches loop over
+enum { WORKLOAD_CODE_SIZE = 64 * 1024 };
+
+// Sets the default parameters: a 1 MiB loop of data accesses with a quarter
+// of instruction fetches
+void workload_defaults(workload_config_t *config);
+
+// Returns a description of why a workload cannot be generated, or NULL if it
+// can
+const char *workload_config_error(const workload_config_t *config);
+
+// Prepares a generator for a valid workload
+void workload_init(workload_t *workload, const workload_config_t *config);
+
+// Generates up to `max` accesses into `out` and returns how many were
+// generated. Returns fewer than `max` only at the end of the workload.
+size_t workload_generate(workload_t *workload, mem_access_t *out, size_t max);
+
+// Parses a workload name ("sequential", "strided", "random", "zipf" or
+// "loop"). Returns 0 on success, or -1 if the name is unknown.
+int parse_workload_kind(const char *str, workload_kind_t *kind);
+
+// Returns the name of a workload kind
+const char *workload_kind_name(workload_kind_t kind);
+
+#endif